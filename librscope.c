@@ -0,0 +1,1832 @@
+// ResampleScope analysis library
+// Copyright (C) 2011-2017 Jason Summers
+
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+
+#include "librscope.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+/////////////// PATTERN GENERATION ///////////////
+
+void rs_pattern_size(int pattern, int *w, int *h)
+{
+	if(pattern==PATTERN_DOTIMG) {
+		*w = DOTIMG_SRC_WIDTH;
+		*h = DOTIMG_SRC_HEIGHT;
+	}
+	else {
+		*w = LINEIMG_SRC_WIDTH;
+		*h = LINEIMG_SRC_HEIGHT;
+	}
+}
+
+#define PATTERN_BG 50 // Background sample value
+#define PATTERN_FG 250 // Sample value of the dots and lines
+
+// Row 'j' of the dot pattern. All rows are blank except the middle row of
+// each strip, which has a dot every DOTIMG_HPIXELSPAN pixels, starting one
+// pixel further to the right in each strip.
+static void gen_dotimg_row(int j, unsigned char *row)
+{
+	int i;
+
+	memset(row,PATTERN_BG,DOTIMG_SRC_WIDTH);
+	if(j%DOTIMG_STRIPHEIGHT!=DOTIMG_VCENTER) return;
+
+	for(i=DOTIMG_HCENTER+j/DOTIMG_STRIPHEIGHT; i<DOTIMG_SRC_WIDTH-DOTIMG_HCENTER;
+		i+=DOTIMG_HPIXELSPAN)
+	{
+		row[i] = PATTERN_FG;
+	}
+}
+
+// Column 'i' of the dot pattern, which is row 'i' of the rotated pattern.
+static void gen_dotimg_column(int i, unsigned char *col)
+{
+	int strip;
+
+	memset(col,PATTERN_BG,DOTIMG_SRC_HEIGHT);
+	if(i<DOTIMG_HCENTER || i>=DOTIMG_SRC_WIDTH-DOTIMG_HCENTER) return;
+
+	for(strip=0;strip<DOTIMG_NUMSTRIPS;strip++) {
+		if((i-strip)%DOTIMG_HPIXELSPAN == DOTIMG_HCENTER) {
+			col[strip*DOTIMG_STRIPHEIGHT+DOTIMG_VCENTER] = PATTERN_FG;
+		}
+	}
+}
+
+void rs_gen_pattern_row(int pattern, int rotated, int j, unsigned char *row)
+{
+	if(pattern==PATTERN_DOTIMG) {
+		if(rotated)
+			gen_dotimg_column(j,row);
+		else
+			gen_dotimg_row(j,row);
+	}
+	else {
+		// Every row of the line pattern is the same: a vertical line in the
+		// middle.
+		if(rotated) {
+			memset(row,(j==LINEIMG_SRC_WIDTH/2)?PATTERN_FG:PATTERN_BG,LINEIMG_SRC_HEIGHT);
+		}
+		else {
+			memset(row,PATTERN_BG,LINEIMG_SRC_WIDTH);
+			row[LINEIMG_SRC_WIDTH/2] = PATTERN_FG;
+		}
+	}
+}
+
+void rs_gen_pattern(int pattern, int rotated, unsigned char *buf)
+{
+	int j;
+	int w, h;
+	int tmp;
+
+	rs_pattern_size(pattern, &w, &h);
+	if(rotated) {
+		tmp = w; w = h; h = tmp;
+	}
+
+	for(j=0;j<h;j++) {
+		rs_gen_pattern_row(pattern,rotated,j,&buf[(size_t)j*w]);
+	}
+}
+
+/////////////// IMAGE DECODING ///////////////
+
+static double srgb_to_linear(double v_srgb)
+{
+	if(v_srgb<=0.04045) {
+		return v_srgb/12.92;
+	}
+	else {
+		return pow( (v_srgb+0.055)/(1.055) , 2.4);
+	}
+}
+
+static double bt709_to_linear(double v_709)
+{
+	if(v_709<0.081) {
+		return v_709/4.5;
+	}
+	else {
+		return pow( (v_709+0.099)/1.099 , 1.0/0.45);
+	}
+}
+
+// Converts from the given transfer curve, to linear.
+// Both the input and output are in the range 0..1.
+static double to_linear(int ccmethod, double gamma, double v)
+{
+	switch(ccmethod) {
+	case CCMETHOD_GAMMA: return pow(v, gamma);
+	case CCMETHOD_SRGB:  return srgb_to_linear(v);
+	case CCMETHOD_BT709: return bt709_to_linear(v);
+	}
+	return v;
+}
+
+// Fills in tbl[0..maxval].
+static void make_cc_table(int ccmethod, double gamma, int maxval, double *tbl)
+{
+	int i;
+	double lin50, lin250;
+
+	if(ccmethod==CCMETHOD_LINEAR) {
+		for(i=0;i<=maxval;i++) {
+			tbl[i] = (double)i*255.0/maxval;
+		}
+		return;
+	}
+
+	// We're assuming the app being tested behaved as follows:
+	// (1) converted the original colors from (e.g.) sRGB to linear;
+	// (2) resized the image in a linear colorspace;
+	// (3) converted back to sRGB.
+
+	// The catch is that after undoing (3), the color is in that app's linear
+	// colorspace, not ours.
+	// If we were to simply multiply the value by 255, then for sRGB, our dark
+	// color would correspond to ~8.1, and our light color to ~243.7.
+	// That's not what we want. We want 50 and 250.
+	// So, we have to be careful to scale and translate it to the correct
+	// range.
+	lin50 = to_linear(ccmethod, gamma, 50.0/255.0);
+	lin250 = to_linear(ccmethod, gamma, 250.0/255.0);
+
+	for(i=0;i<=maxval;i++) {
+		// First, undo (3) by converting to linear[0..1]. Then rescale.
+		tbl[i] = (to_linear(ccmethod, gamma, (double)i/maxval)-lin50) *
+			((250.0-50.0)/(lin250-lin50)) + 50.0;
+	}
+}
+
+void rs_make_cc_table(int ccmethod, double gamma, double *tbl)
+{
+	make_cc_table(ccmethod,gamma,255,tbl);
+}
+
+void rs_make_cc_table16(int ccmethod, double gamma, double *tbl)
+{
+	make_cc_table(ccmethod,gamma,65535,tbl);
+}
+
+int rs_image_init(struct rs_image *img, int w, int h)
+{
+	img->w = w;
+	img->h = h;
+	img->pixels = malloc(sizeof(double)*(size_t)w*(size_t)h);
+	return img->pixels ? 1 : 0;
+}
+
+void rs_image_free(struct rs_image *img)
+{
+	free(img->pixels);
+	img->pixels = NULL;
+}
+
+void rs_image_put_row_u8(struct rs_image *img, int rotated, int y,
+	const unsigned char *src, int bytes_per_pixel, int channel,
+	const double *cc_table)
+{
+	int x;
+	int n;
+	size_t step;
+	double *p;
+
+	if(rotated) {
+		n = img->h;
+		p = &img->pixels[y];
+		step = (size_t)img->w;
+	}
+	else {
+		n = img->w;
+		p = &img->pixels[(size_t)y*img->w];
+		step = 1;
+	}
+
+	src += channel;
+	for(x=0;x<n;x++) {
+		*p = cc_table[*src];
+		src += bytes_per_pixel;
+		p += step;
+	}
+}
+
+/////////////// RESAMPLING ///////////////
+
+int rs_filter_from_name(const char *name, struct rs_filter *f)
+{
+	char *endp;
+
+	memset(f,0,sizeof(struct rs_filter));
+
+	if(!strcmp(name,"box")) {
+		f->type = RS_FILTER_BOX;
+	}
+	else if(!strcmp(name,"triangle")) {
+		f->type = RS_FILTER_TRIANGLE;
+	}
+	else if(!strcmp(name,"catmullrom")) {
+		f->type = RS_FILTER_CUBIC;
+		f->b = 0.0; f->c = 0.5;
+	}
+	else if(!strcmp(name,"mitchell")) {
+		f->type = RS_FILTER_CUBIC;
+		f->b = 1.0/3.0; f->c = 1.0/3.0;
+	}
+	else if(!strcmp(name,"bspline")) {
+		f->type = RS_FILTER_CUBIC;
+		f->b = 1.0; f->c = 0.0;
+	}
+	else if(!strcmp(name,"hermite")) {
+		f->type = RS_FILTER_CUBIC;
+		f->b = 0.0; f->c = 0.0;
+	}
+	else if(!strncmp(name,"cubic:",6)) {
+		f->type = RS_FILTER_CUBIC;
+		f->b = strtod(&name[6],&endp);
+		if(*endp!=',') return 0;
+		f->c = strtod(endp+1,&endp);
+		if(*endp!='\0') return 0;
+	}
+	else if(!strncmp(name,"lanczos",7)) {
+		f->type = RS_FILTER_LANCZOS;
+		if(name[7]=='\0') {
+			f->lobes = 3;
+		}
+		else {
+			f->lobes = (int)strtol(&name[7],&endp,10);
+			if(*endp!='\0' || f->lobes<1 || f->lobes>100) return 0;
+		}
+	}
+	else if(!strcmp(name,"gaussian")) {
+		f->type = RS_FILTER_GAUSSIAN;
+		f->sigma = 0.5;
+	}
+	else if(!strncmp(name,"gaussian:",9)) {
+		f->type = RS_FILTER_GAUSSIAN;
+		f->sigma = strtod(&name[9],&endp);
+		if(*endp!='\0' || f->sigma<0.01 || f->sigma>100.0) return 0;
+	}
+	else {
+		return 0;
+	}
+	return 1;
+}
+
+double rs_filter_radius(const struct rs_filter *f)
+{
+	switch(f->type) {
+	case RS_FILTER_BOX: return 0.5;
+	case RS_FILTER_TRIANGLE: return 1.0;
+	case RS_FILTER_CUBIC: return 2.0;
+	case RS_FILTER_LANCZOS: return (double)f->lobes;
+	case RS_FILTER_GAUSSIAN: return 4.0*f->sigma;
+	}
+	return 0.0;
+}
+
+static int cubic_is(const struct rs_filter *f, double b, double c)
+{
+	return fabs(f->b-b)<0.000001 && fabs(f->c-c)<0.000001;
+}
+
+void rs_filter_name(const struct rs_filter *f, char *buf)
+{
+	switch(f->type) {
+	case RS_FILTER_BOX:
+		strcpy(buf,"box");
+		return;
+	case RS_FILTER_TRIANGLE:
+		strcpy(buf,"triangle");
+		return;
+	case RS_FILTER_CUBIC:
+		if(cubic_is(f,0.0,0.5)) strcpy(buf,"catmullrom");
+		else if(cubic_is(f,1.0/3.0,1.0/3.0)) strcpy(buf,"mitchell");
+		else if(cubic_is(f,1.0,0.0)) strcpy(buf,"bspline");
+		else if(cubic_is(f,0.0,0.0)) strcpy(buf,"hermite");
+		else sprintf(buf,"cubic:%.4g,%.4g",f->b,f->c);
+		return;
+	case RS_FILTER_LANCZOS:
+		sprintf(buf,"lanczos%d",f->lobes);
+		return;
+	case RS_FILTER_GAUSSIAN:
+		if(f->sigma==0.5) strcpy(buf,"gaussian");
+		else sprintf(buf,"gaussian:%.4g",f->sigma);
+		return;
+	}
+	strcpy(buf,"unknown");
+}
+
+static double sinc(double x)
+{
+	if(x==0.0) return 1.0;
+	x *= M_PI;
+	return sin(x)/x;
+}
+
+double rs_filter_eval(const struct rs_filter *f, double x)
+{
+	double b, c;
+
+	if(x<0.0) x = -x;
+
+	switch(f->type) {
+	case RS_FILTER_BOX:
+		return (x<0.5) ? 1.0 : 0.0;
+	case RS_FILTER_TRIANGLE:
+		return (x<1.0) ? 1.0-x : 0.0;
+	case RS_FILTER_CUBIC:
+		b = f->b;
+		c = f->c;
+		if(x<1.0) {
+			return ((12.0-9.0*b-6.0*c)*x*x*x + (-18.0+12.0*b+6.0*c)*x*x +
+				(6.0-2.0*b))/6.0;
+		}
+		if(x<2.0) {
+			return ((-b-6.0*c)*x*x*x + (6.0*b+30.0*c)*x*x +
+				(-12.0*b-48.0*c)*x + (8.0*b+24.0*c))/6.0;
+		}
+		return 0.0;
+	case RS_FILTER_LANCZOS:
+		if(x<(double)f->lobes) return sinc(x)*sinc(x/f->lobes);
+		return 0.0;
+	case RS_FILTER_GAUSSIAN:
+		// Normalized to an area of 1, like the other filters.
+		if(x<4.0*f->sigma)
+			return exp(-x*x/(2.0*f->sigma*f->sigma))/(f->sigma*sqrt(2.0*M_PI));
+		return 0.0;
+	}
+	return 0.0;
+}
+
+static double linear_to_srgb(double v_linear)
+{
+	if(v_linear<=0.0031308) {
+		return 12.92*v_linear;
+	}
+	return 1.055*pow(v_linear,1.0/2.4) - 0.055;
+}
+
+// The source pixels and weights that make up each target pixel.
+struct rs_weights {
+	int num_taps; // Taps per target pixel. Unused taps have weight 0.
+	int *idx; // [dst_len*num_taps]
+	double *w; // [dst_len*num_taps]
+};
+
+// Calculates the weights for resizing from src_len to dst_len pixels.
+// Pixels beyond the edges of the source are treated as copies of the edge
+// pixels.
+static int calc_weights(const struct rs_filter *f, int src_len, int dst_len,
+	struct rs_weights *wts)
+{
+	double scale; // Target pixels per source pixel
+	double fscale; // How much the filter is stretched
+	double radius;
+	double center;
+	double tot;
+	int *idx;
+	double *w;
+	int x, k, t;
+	int lo;
+
+	scale = (double)dst_len/(double)src_len;
+	fscale = (scale<1.0) ? 1.0/scale : 1.0;
+	radius = rs_filter_radius(f)*fscale;
+
+	wts->num_taps = (int)ceil(2.0*radius)+1;
+	wts->idx = malloc(sizeof(int)*(size_t)dst_len*wts->num_taps);
+	wts->w = malloc(sizeof(double)*(size_t)dst_len*wts->num_taps);
+	if(!wts->idx || !wts->w) return 0;
+
+	for(x=0;x<dst_len;x++) {
+		idx = &wts->idx[(size_t)x*wts->num_taps];
+		w = &wts->w[(size_t)x*wts->num_taps];
+
+		// The position of the center of this target pixel, in source
+		// pixel coordinates.
+		center = ((double)x+0.5)/scale - 0.5;
+		lo = (int)ceil(center-radius);
+
+		tot = 0.0;
+		for(t=0;t<wts->num_taps;t++) {
+			k = lo+t;
+			w[t] = rs_filter_eval(f,((double)k-center)/fscale);
+			tot += w[t];
+			if(k<0) k=0;
+			if(k>src_len-1) k=src_len-1;
+			idx[t] = k;
+		}
+
+		if(tot==0.0) {
+			// Shouldn't happen, but just in case, use the nearest pixel.
+			k = (int)floor(center+0.5);
+			if(k<0) k=0;
+			if(k>src_len-1) k=src_len-1;
+			idx[0] = k;
+			w[0] = 1.0;
+			for(t=1;t<wts->num_taps;t++) {
+				w[t] = 0.0;
+			}
+			continue;
+		}
+
+		for(t=0;t<wts->num_taps;t++) {
+			w[t] /= tot;
+		}
+	}
+	return 1;
+}
+
+int rs_simulate(int pattern, int rotated, const struct rs_filter *f,
+	int srgb, int dst_width, unsigned char *buf)
+{
+	int src_w, src_h;
+	unsigned char *pat = NULL;
+	double *src = NULL;
+	double *dst = NULL;
+	double tbl[256];
+	struct rs_weights wts;
+	const double *s;
+	double *d;
+	double wt, v;
+	size_t i, n;
+	int x, t, j;
+	int retval = 0;
+
+	memset(&wts,0,sizeof(struct rs_weights));
+	rs_pattern_size(pattern,&src_w,&src_h);
+
+	// Everything is done with the pattern transposed, so that the samples
+	// in each column are contiguous. Then, producing a target column is just
+	// a weighted sum of a few source columns, which is easy to vectorize.
+	n = (size_t)src_w*src_h;
+	pat = malloc(n);
+	src = malloc(sizeof(double)*n);
+	dst = malloc(sizeof(double)*(size_t)dst_width*src_h);
+	if(!pat || !src || !dst) goto done;
+	if(!calc_weights(f,src_w,dst_width,&wts)) goto done;
+
+	for(i=0;i<256;i++) {
+		tbl[i] = srgb ? srgb_to_linear((double)i/255.0) : (double)i;
+	}
+
+	rs_gen_pattern(pattern,1,pat);
+	for(i=0;i<n;i++) {
+		src[i] = tbl[pat[i]];
+	}
+
+	for(x=0;x<dst_width;x++) {
+		d = &dst[(size_t)x*src_h];
+		for(j=0;j<src_h;j++) {
+			d[j] = 0.0;
+		}
+		for(t=0;t<wts.num_taps;t++) {
+			wt = wts.w[(size_t)x*wts.num_taps+t];
+			if(wt==0.0) continue;
+			s = &src[(size_t)wts.idx[(size_t)x*wts.num_taps+t]*src_h];
+			for(j=0;j<src_h;j++) {
+				d[j] += wt*s[j];
+			}
+		}
+	}
+
+	// Convert to 8 bits, and un-transpose if needed.
+	for(x=0;x<dst_width;x++) {
+		d = &dst[(size_t)x*src_h];
+		for(j=0;j<src_h;j++) {
+			v = d[j];
+			if(srgb) {
+				if(v<0.0) v=0.0;
+				v = 255.0*linear_to_srgb(v);
+			}
+			v = floor(v+0.5);
+			if(v<0.0) v=0.0;
+			if(v>255.0) v=255.0;
+			if(rotated)
+				buf[(size_t)x*src_h + j] = (unsigned char)v;
+			else
+				buf[(size_t)j*dst_width + x] = (unsigned char)v;
+		}
+	}
+
+	retval = 1;
+done:
+	free(pat);
+	free(src);
+	free(dst);
+	free(wts.idx);
+	free(wts.w);
+	return retval;
+}
+
+/////////////// ANALYSIS ///////////////
+
+int rs_detect_pattern(const struct rs_image *img)
+{
+	int i;
+
+	// Look at the top row. If it contains any bright pixels, assume PATTERN_LINEIMG.
+	// Otherwise, assume PATTERN_DOTIMG
+	for(i=0;i<img->w;i++) {
+		if(img->pixels[i]>=99.9)
+			return PATTERN_LINEIMG;
+	}
+
+	return PATTERN_DOTIMG;
+}
+
+// Returns 0, and sets r->errcode, if the resulting scale factor can't be
+// used.
+static int decide_scale_factor(struct rs_result *r, const struct rs_params *params,
+	int src_width)
+{
+	// Start with the default scale factor:
+	r->scale_factor = ((double)r->w) / src_width;
+	r->natural_scale_factor = r->scale_factor;
+
+	if(params->scale_factor_req_set) {
+		// scale factor overridden by user
+		r->scale_factor = params->scale_factor_req;
+	}
+
+	if(params->scale_fudge_factor_req_set) {
+		// adjust the scale factor as requested
+		r->scale_factor *= params->scale_fudge_factor_req;
+	}
+
+	// (This is also false for NaN.)
+	if(!(r->scale_factor>0.0 && r->scale_factor<=DBL_MAX)) {
+		r->errcode = RS_ERR_BADSCALE;
+		return 0;
+	}
+	return 1;
+}
+
+//////////////////// DOTIMG ////////////////////
+
+// Convert the position of a "0" point (the center of a bright pixel) in the
+// source image to target image coordinates.
+static double dotimg_zero_point(const struct rs_result *r, int k)
+{
+	// I don't really remember why this formula works, but it seems to.
+	return (r->scale_factor)*(((double)k) + 0.5 - ((double)DOTIMG_SRC_WIDTH)/2.0) + (r->w/2.0)  - 0.5;
+}
+
+// Add up the DOTIMG_STRIPHEIGHT pixels vertically in each column of each
+// strip, in a single pass through the image.
+// Ideally, all but the middle one will be empty, but in reality most
+// filters get applied vertically as well as horizontally, which can
+// cause vertical blurring depending on the filter. This is how we
+// undo that.
+// Returns an array of DOTIMG_NUMSTRIPS*img->w sums, or NULL on error.
+static double *calc_strip_sums(const struct rs_image *img)
+{
+	double *sums;
+	double *s;
+	const double *p;
+	int i, j;
+
+	sums = calloc((size_t)DOTIMG_NUMSTRIPS*img->w, sizeof(double));
+	if(!sums) return NULL;
+
+	p = img->pixels;
+	for(j=0;j<DOTIMG_SRC_HEIGHT;j++) {
+		s = &sums[(size_t)(j/DOTIMG_STRIPHEIGHT)*img->w];
+		for(i=0;i<img->w;i++) {
+			s[i] += (*p++)-50.0;
+		}
+	}
+	return sums;
+}
+
+// Calculate the samples for the given "strip".
+// The first DOTIMG_STRIPHEIGHT scalines are strip 0,
+//    the next DOTIMG_STRIPHEIGHT are strip 1, etc.
+// 'sums' is from calc_strip_sums().
+static void analyze_strip(struct rs_result *r, int stripnum, const double *sums)
+{
+	int dstpos,k,n;
+	int num_zp;
+	double zp_first, zp_step;
+	double value;
+	double tmp_offset;
+	double offset; // Relative position of the nearest "0" point, in target image coords.
+	struct rs_sample *smpl;
+
+	// There are "0" points at ({5,16,27,38...}+stripnum) * scale_factor.
+	// The first is source pixel (DOTIMG_HCENTER+stripnum), and they are
+	// DOTIMG_HPIXELSPAN pixels apart.
+	num_zp = (DOTIMG_SRC_WIDTH-2*DOTIMG_HCENTER-stripnum+DOTIMG_HPIXELSPAN-1)/DOTIMG_HPIXELSPAN;
+	zp_first = dotimg_zero_point(r,DOTIMG_HCENTER+stripnum);
+	zp_step = r->scale_factor*DOTIMG_HPIXELSPAN;
+	if(!(zp_step>0.0)) return; // The search below needs a positive step
+
+	for(dstpos=0;dstpos<r->w;dstpos++) {
+
+		// Calculate which "0" point is nearest. Because of rounding error, it
+		// could be off by one, so check its neighbors as well.
+		n = (int)floor((((double)dstpos)-zp_first)/zp_step + 0.5);
+		if(n<0) n=0;
+		if(n>num_zp-1) n=num_zp-1;
+
+		offset = 10000.0; // (too far)
+		for(k=n-1; k<=n+1; k++) {
+			if(k<0 || k>=num_zp) continue;
+
+			// The directed distance to this 0 point.
+			tmp_offset = ((double)dstpos)-
+				dotimg_zero_point(r,DOTIMG_HCENTER+stripnum+k*DOTIMG_HPIXELSPAN);
+
+			// Keep track of the smallest (in absolute value) distance.
+			if(fabs(tmp_offset)<fabs(offset)) {
+				offset = tmp_offset;
+			}
+		}
+
+		// Make sure the offset is small enough to be meaningful
+		// TODO: This might only be correct when downscaling.
+		if(fabs(offset)>(r->scale_factor*DOTIMG_HCENTER)) continue;
+
+		// Convert (0 to 200) to (0 to 1).
+		value = sums[(size_t)stripnum*r->w + dstpos]/200.0;
+
+		if(r->scale_factor < 1.0) {
+			// Compensate for the fact that we're shrinking the image, which
+			// reduces the size of a pixel, making it dimmer.
+			// This factor is normally about 0.996, so this will only make
+			// a small difference.
+			value /= r->scale_factor;
+		}
+		else {
+			offset /= r->scale_factor;
+		}
+
+		smpl = &r->samples[r->num_samples++];
+		smpl->x = offset;
+		smpl->y = value;
+		smpl->strip = stripnum;
+	}
+}
+
+static int cmp_sample_x(const void *a, const void *b)
+{
+	double xa = ((const struct rs_sample*)a)->x;
+	double xb = ((const struct rs_sample*)b)->x;
+	if(xa<xb) return -1;
+	if(xa>xb) return 1;
+	return 0;
+}
+
+// Calculates r->scatter. Returns 0 on failure.
+static int calc_scatter(struct rs_result *r)
+{
+	struct rs_sample *sorted;
+	double tot = 0.0;
+	double d;
+	int i;
+
+	if(r->num_samples<2) return 1;
+
+	sorted = malloc(sizeof(struct rs_sample)*(size_t)r->num_samples);
+	if(!sorted) return 0;
+	memcpy(sorted,r->samples,sizeof(struct rs_sample)*(size_t)r->num_samples);
+	qsort(sorted,r->num_samples,sizeof(struct rs_sample),cmp_sample_x);
+
+	for(i=1;i<r->num_samples;i++) {
+		d = sorted[i].y - sorted[i-1].y;
+		tot += d*d;
+	}
+	free(sorted);
+
+	r->scatter = sqrt(tot/(r->num_samples-1));
+	r->has_scatter = 1;
+	return 1;
+}
+
+// Calculates the samples for all strips, given the strip sums and
+// r->scale_factor.
+static int dotimg_samples_from_sums(struct rs_result *r, const double *sums)
+{
+	int i;
+
+	r->num_samples = 0;
+	r->samples = malloc(sizeof(struct rs_sample)*(size_t)DOTIMG_NUMSTRIPS*r->w);
+	if(!r->samples) return 0;
+
+	for(i=0;i<DOTIMG_NUMSTRIPS;i++) {
+		analyze_strip(r,i,sums);
+	}
+
+	return calc_scatter(r);
+}
+
+// Checks whether an image of this size (after rotation) could be the dot
+// pattern. If not, sets *errcode.
+static int dotimg_check_size(int w, int h, int *errcode)
+{
+	if(h != DOTIMG_SRC_HEIGHT) {
+		*errcode = RS_ERR_BADHEIGHT;
+		return 0;
+	}
+	if(w<50) {
+		*errcode = RS_ERR_BADWIDTH;
+		return 0;
+	}
+	return 1;
+}
+
+// 'sums' is from calc_strip_sums(), or from a stream.
+static int analyze_dotimg_sums(const double *sums, const struct rs_params *params,
+	struct rs_result *r)
+{
+	if(!decide_scale_factor(r,params,DOTIMG_SRC_WIDTH)) return 0;
+
+	if(!dotimg_samples_from_sums(r,sums)) {
+		r->errcode = RS_ERR_NOMEM;
+		return 0;
+	}
+	return 1;
+}
+
+static int analyze_dotimg(const struct rs_image *img, const struct rs_params *params,
+	struct rs_result *r)
+{
+	double *sums = NULL;
+	int ret;
+
+	if(!dotimg_check_size(img->w,img->h,&r->errcode)) return 0;
+
+	sums = calc_strip_sums(img);
+	if(!sums) {
+		r->errcode = RS_ERR_NOMEM;
+		return 0;
+	}
+
+	ret = analyze_dotimg_sums(sums,params,r);
+	free(sums);
+	return ret;
+}
+
+// Number of candidates in the first (coarse) pass of the fudge factor
+// search, and in each refinement pass.
+#define FF_NUM_COARSE  81
+#define FF_NUM_FINE    21
+#define FF_NUM_PASSES  6
+
+// State for rs_dotimg_find_ff().
+struct ff_search {
+	const double *sums;
+	struct rs_result base; // Has the default scale factor.
+	int num_candidates;
+	double *candidates; // The fudge factors to evaluate
+	double *scatter; // The results. -1 = failed
+};
+
+static void ff_search_eval(void *arg, int i)
+{
+	struct ff_search *ffs = (struct ff_search*)arg;
+	struct rs_result r;
+
+	r = ffs->base;
+	r.scale_factor *= ffs->candidates[i];
+	r.samples = NULL;
+	if(dotimg_samples_from_sums(&r,ffs->sums) && r.has_scatter)
+		ffs->scatter[i] = r.scatter;
+	else
+		ffs->scatter[i] = -1.0;
+	free(r.samples);
+}
+
+static void serial_for(void *userdata, int n,
+	void (*fn)(void *arg, int i), void *arg)
+{
+	int i;
+	for(i=0;i<n;i++) {
+		fn(arg,i);
+	}
+}
+
+// The fudge factor search, given the strip sums of an image that is known to
+// be the right size.
+static int find_ff_from_sums(const double *sums, int w, int h,
+	const struct rs_params *params,
+	double range, rs_parallel_for_fn pfor, void *pfor_userdata,
+	double *ff, double *scatter)
+{
+	struct ff_search ffs;
+	double lo, hi, step;
+	double best_ff = 1.0;
+	double best_scatter = -1.0;
+	int pass, i, n;
+	int retval = 0;
+
+	if(!pfor) pfor = serial_for;
+
+	memset(&ffs,0,sizeof(struct ff_search));
+	ffs.base.pattern = PATTERN_DOTIMG;
+	ffs.base.w = w;
+	ffs.base.h = h;
+	if(!decide_scale_factor(&ffs.base,params,DOTIMG_SRC_WIDTH)) return 0;
+
+	ffs.candidates = malloc(sizeof(double)*FF_NUM_COARSE);
+	ffs.scatter = malloc(sizeof(double)*FF_NUM_COARSE);
+	if(!ffs.candidates || !ffs.scatter) goto done;
+	ffs.sums = sums;
+
+	lo = 1.0-range;
+	hi = 1.0+range;
+	for(pass=0;pass<FF_NUM_PASSES;pass++) {
+		n = (pass==0) ? FF_NUM_COARSE : FF_NUM_FINE;
+		step = (hi-lo)/(n-1);
+		for(i=0;i<n;i++) {
+			ffs.candidates[i] = lo + step*i;
+		}
+		ffs.num_candidates = n;
+
+		pfor(pfor_userdata,n,ff_search_eval,&ffs);
+
+		for(i=0;i<n;i++) {
+			if(ffs.scatter[i]<0.0) continue;
+			if(best_scatter<0.0 || ffs.scatter[i]<best_scatter) {
+				best_scatter = ffs.scatter[i];
+				best_ff = ffs.candidates[i];
+			}
+		}
+		if(best_scatter<0.0) goto done;
+
+		// Search the neighborhood of the best candidate more closely.
+		lo = best_ff - step;
+		hi = best_ff + step;
+	}
+
+	*ff = best_ff;
+	*scatter = best_scatter;
+	retval = 1;
+done:
+	free(ffs.candidates);
+	free(ffs.scatter);
+	return retval;
+}
+
+int rs_dotimg_find_ff(const struct rs_image *img, const struct rs_params *params,
+	double range, rs_parallel_for_fn pfor, void *pfor_userdata,
+	double *ff, double *scatter)
+{
+	double *sums;
+	int errcode;
+	int ret;
+
+	if(!dotimg_check_size(img->w,img->h,&errcode)) return 0;
+	sums = calc_strip_sums(img);
+	if(!sums) return 0;
+	ret = find_ff_from_sums(sums,img->w,img->h,params,range,pfor,pfor_userdata,
+		ff,scatter);
+	free(sums);
+	return ret;
+}
+
+//////////////////// LINEIMG ///////////////////
+
+static int lineimg_check_size(int h, int *errcode)
+{
+	if(h < 3) {
+		*errcode = RS_ERR_TOOSMALL;
+		return 0;
+	}
+	return 1;
+}
+
+// 'rows' is the three rows (of r->w samples each) in the middle of the
+// image: the one at h/2, and the ones above and below it.
+static int analyze_lineimg_rows(const double *rows, const struct rs_params *params,
+	struct rs_result *r)
+{
+	int i;
+	double v;
+	double xp, yp;
+	double tot = 0.0;
+	struct rs_sample *smpl;
+
+	if(!decide_scale_factor(r,params,LINEIMG_SRC_WIDTH)) return 0;
+
+	r->samples = malloc(sizeof(struct rs_sample)*(size_t)r->w);
+	if(!r->samples) {
+		r->errcode = RS_ERR_NOMEM;
+		return 0;
+	}
+
+	for(i=0;i<r->w;i++) {
+		// Read from three different scanlines, to give us a chance of
+		// detecting weird issues where the scanlines aren't identical.
+		v = rows[(size_t)(i%3)*r->w + i];
+
+		yp = (v-50.0)/200.0;
+		tot += yp;
+		xp = 0.5+(double)i-(((double)r->w)/2.0);
+
+		if(r->scale_factor < 1.0) {
+			yp /= r->scale_factor;
+		}
+		else {
+			xp /= r->scale_factor;
+		}
+
+		smpl = &r->samples[r->num_samples++];
+		smpl->x = xp;
+		smpl->y = yp;
+		smpl->strip = 0;
+	}
+
+	r->area = tot/r->scale_factor;
+	r->has_area = 1;
+	return 1;
+}
+
+static int analyze_lineimg(const struct rs_image *img, const struct rs_params *params,
+	struct rs_result *r)
+{
+	int scanline; // The (middle) scanline we'll analyze
+
+	if(!lineimg_check_size(img->h,&r->errcode)) return 0;
+
+	scanline = img->h / 2;
+	return analyze_lineimg_rows(&img->pixels[(size_t)(scanline-1)*img->w],params,r);
+}
+
+///////////////////////////////////////////////
+
+static void calc_support(struct rs_result *r, const struct rs_params *params)
+{
+	double threshold;
+	int i;
+
+	// Without a usable scale factor, there's nothing meaningful to report;
+	// r->has_support stays 0. (decide_scale_factor() normally catches this.)
+	if(!(r->scale_factor>0.0 && r->scale_factor<=DBL_MAX)) return;
+
+	threshold = params->support_threshold_req_set ?
+		params->support_threshold_req : RS_DEFAULT_SUPPORT_THRESHOLD;
+
+	r->support = 0.0;
+	for(i=0;i<r->num_samples;i++) {
+		if(fabs(r->samples[i].y)>threshold && fabs(r->samples[i].x)>r->support) {
+			r->support = fabs(r->samples[i].x);
+		}
+	}
+
+	// When reducing, the samples are in target pixels, and the filter is
+	// stretched to cover more source pixels.
+	if(r->scale_factor < 1.0)
+		r->support_src = r->support/r->scale_factor;
+	else
+		r->support_src = r->support;
+
+	r->taps = (int)ceil(2.0*r->support_src - 0.000001);
+	if(r->taps<1) r->taps = 1;
+	r->has_support = 1;
+}
+
+int rs_analyze(const struct rs_image *img, int pattern,
+	const struct rs_params *params, struct rs_result *r)
+{
+	int ret;
+
+	memset(r,0,sizeof(struct rs_result));
+	r->pattern = pattern;
+	r->w = img->w;
+	r->h = img->h;
+
+	if(pattern==PATTERN_DOTIMG)
+		ret = analyze_dotimg(img,params,r);
+	else
+		ret = analyze_lineimg(img,params,r);
+
+	if(ret) {
+		calc_support(r,params);
+	}
+	else {
+		free(r->samples);
+		r->samples = NULL;
+		r->num_samples = 0;
+	}
+	return ret;
+}
+
+void rs_result_free(struct rs_result *r)
+{
+	free(r->samples);
+	r->samples = NULL;
+	r->num_samples = 0;
+}
+
+//////////////////// STREAMING ////////////////////
+
+// Instead of storing the image, we update the same things that
+// calc_strip_sums() and analyze_lineimg() would compute, as each row
+// arrives, in the same order, so that the results are identical.
+
+int rs_stream_init(struct rs_stream *s, int pattern, int rotated,
+	int file_w, int file_h)
+{
+	int errcode;
+
+	memset(s,0,sizeof(struct rs_stream));
+	s->pattern = pattern;
+	s->rotated = rotated;
+	s->file_w = file_w;
+	s->file_h = file_h;
+	s->w = rotated ? file_h : file_w;
+	s->h = rotated ? file_w : file_h;
+	s->scanline = s->h / 2;
+
+	// If we know the pattern, we can reject an image of the wrong size
+	// before any of it is decoded.
+	if(pattern==PATTERN_DOTIMG && !dotimg_check_size(s->w,s->h,&s->errcode))
+		return 0;
+	if(pattern==PATTERN_LINEIMG && !lineimg_check_size(s->h,&s->errcode))
+		return 0;
+
+	if(pattern!=PATTERN_LINEIMG && dotimg_check_size(s->w,s->h,&errcode)) {
+		s->sums = calloc((size_t)DOTIMG_NUMSTRIPS*s->w, sizeof(double));
+		if(!s->sums) goto nomem;
+	}
+	if(pattern!=PATTERN_DOTIMG && lineimg_check_size(s->h,&errcode)) {
+		s->line_rows = calloc((size_t)3*s->w, sizeof(double));
+		if(!s->line_rows) goto nomem;
+	}
+	s->row = malloc(sizeof(double)*(size_t)file_w);
+	if(!s->row) goto nomem;
+	return 1;
+
+nomem:
+	s->errcode = RS_ERR_NOMEM;
+	return 0;
+}
+
+int rs_stream_row_needed(const struct rs_stream *s, int y)
+{
+	// If rotated, each row of the file is a column of the image.
+	if(s->rotated) return 1;
+
+	if(s->pattern==0 && y==0) return 1; // For rs_stream_detect_pattern()
+	if(s->sums && y<DOTIMG_SRC_HEIGHT) return 1;
+	if(s->line_rows && y>=s->scanline-1 && y<=s->scanline+1) return 1;
+	return 0;
+}
+
+void rs_stream_put_row(struct rs_stream *s, int y, const double *v)
+{
+	int i, j;
+	double *p;
+
+	if(s->rotated) {
+		// Row y of the file is column y of the image.
+		if(v[0]>=99.9) s->top_row_bright = 1;
+		if(s->sums) {
+			for(j=0;j<DOTIMG_SRC_HEIGHT;j++) {
+				s->sums[(size_t)(j/DOTIMG_STRIPHEIGHT)*s->w + y] += v[j]-50.0;
+			}
+		}
+		if(s->line_rows) {
+			for(j=0;j<3;j++) {
+				s->line_rows[(size_t)j*s->w + y] = v[s->scanline-1+j];
+			}
+		}
+		return;
+	}
+
+	if(y==0) {
+		for(i=0;i<s->w;i++) {
+			if(v[i]>=99.9) {
+				s->top_row_bright = 1;
+				break;
+			}
+		}
+	}
+	if(s->sums && y<DOTIMG_SRC_HEIGHT) {
+		p = &s->sums[(size_t)(y/DOTIMG_STRIPHEIGHT)*s->w];
+		for(i=0;i<s->w;i++) {
+			p[i] += v[i]-50.0;
+		}
+	}
+	if(s->line_rows && y>=s->scanline-1 && y<=s->scanline+1) {
+		memcpy(&s->line_rows[(size_t)(y-(s->scanline-1))*s->w], v, sizeof(double)*(size_t)s->w);
+	}
+}
+
+void rs_stream_put_row_u8(struct rs_stream *s, int y,
+	const unsigned char *src, int bytes_per_pixel, int channel,
+	const double *cc_table)
+{
+	int x;
+
+	src += channel;
+	for(x=0;x<s->file_w;x++) {
+		s->row[x] = cc_table[src[(size_t)x*bytes_per_pixel]];
+	}
+	rs_stream_put_row(s,y,s->row);
+}
+
+void rs_stream_put_row_u16(struct rs_stream *s, int y,
+	const unsigned short *src, int samples_per_pixel, int channel,
+	const double *cc_table)
+{
+	int x;
+
+	src += channel;
+	for(x=0;x<s->file_w;x++) {
+		s->row[x] = cc_table[src[(size_t)x*samples_per_pixel]];
+	}
+	rs_stream_put_row(s,y,s->row);
+}
+
+int rs_stream_detect_pattern(const struct rs_stream *s)
+{
+	// Same as rs_detect_pattern().
+	return s->top_row_bright ? PATTERN_LINEIMG : PATTERN_DOTIMG;
+}
+
+int rs_stream_analyze(const struct rs_stream *s, int pattern,
+	const struct rs_params *params, struct rs_result *r)
+{
+	int ret = 0;
+
+	memset(r,0,sizeof(struct rs_result));
+	r->pattern = pattern;
+	r->w = s->w;
+	r->h = s->h;
+
+	if(pattern==PATTERN_DOTIMG) {
+		if(dotimg_check_size(s->w,s->h,&r->errcode) && s->sums)
+			ret = analyze_dotimg_sums(s->sums,params,r);
+	}
+	else {
+		if(lineimg_check_size(s->h,&r->errcode) && s->line_rows)
+			ret = analyze_lineimg_rows(s->line_rows,params,r);
+	}
+
+	if(ret) {
+		calc_support(r,params);
+	}
+	else {
+		free(r->samples);
+		r->samples = NULL;
+		r->num_samples = 0;
+	}
+	return ret;
+}
+
+int rs_stream_find_ff(const struct rs_stream *s, const struct rs_params *params,
+	double range, rs_parallel_for_fn pfor, void *pfor_userdata,
+	double *ff, double *scatter)
+{
+	if(!s->sums) return 0;
+	return find_ff_from_sums(s->sums,s->w,s->h,params,range,pfor,pfor_userdata,
+		ff,scatter);
+}
+
+void rs_stream_free(struct rs_stream *s)
+{
+	free(s->sums);
+	s->sums = NULL;
+	free(s->line_rows);
+	s->line_rows = NULL;
+	free(s->row);
+	s->row = NULL;
+}
+
+//////////////////// IDENTIFICATION ////////////////////
+
+#define ID_MAX_CANDIDATES 200
+
+// State for rs_identify().
+struct id_search {
+	int num_samples;
+	// The samples, as separate arrays, so the inner loop only touches what
+	// it needs.
+	double *x;
+	double *y;
+	double yy; // Sum of y*y
+	int num_candidates;
+	struct rs_match *candidates;
+};
+
+static void id_add(struct id_search *ids, int type, double b, double c,
+	int lobes, double sigma)
+{
+	struct rs_match *m;
+
+	if(ids->num_candidates>=ID_MAX_CANDIDATES) return;
+	m = &ids->candidates[ids->num_candidates++];
+	memset(m,0,sizeof(struct rs_match));
+	m->filter.type = type;
+	m->filter.b = b;
+	m->filter.c = c;
+	m->filter.lobes = lobes;
+	m->filter.sigma = sigma;
+}
+
+// The library of filters to try.
+static void id_make_candidates(struct id_search *ids)
+{
+	int i, j;
+
+	id_add(ids,RS_FILTER_BOX,0.0,0.0,0,0.0);
+	id_add(ids,RS_FILTER_TRIANGLE,0.0,0.0,0,0.0);
+
+	// Cubics with B and C from 0 to 1, which includes Hermite, Catmull-Rom,
+	// and B-spline. Mitchell (1/3,1/3) isn't on the grid, so add it too.
+	for(j=0;j<=10;j++) {
+		for(i=0;i<=10;i++) {
+			id_add(ids,RS_FILTER_CUBIC,(double)j/10.0,(double)i/10.0,0,0.0);
+		}
+	}
+	id_add(ids,RS_FILTER_CUBIC,1.0/3.0,1.0/3.0,0,0.0);
+
+	for(i=2;i<=8;i++) {
+		id_add(ids,RS_FILTER_LANCZOS,0.0,0.0,i,0.0);
+	}
+
+	for(i=6;i<=20;i++) {
+		id_add(ids,RS_FILTER_GAUSSIAN,0.0,0.0,0,(double)i/20.0);
+	}
+}
+
+// Finds the least-squares amplitude for candidate i, and its residual.
+static void id_eval(void *arg, int i)
+{
+	struct id_search *ids = (struct id_search*)arg;
+	struct rs_match *m = &ids->candidates[i];
+	double k;
+	double ky = 0.0;
+	double kk = 0.0;
+	double ss;
+	int j;
+
+	for(j=0;j<ids->num_samples;j++) {
+		k = rs_filter_eval(&m->filter,ids->x[j]);
+		ky += k*ids->y[j];
+		kk += k*k;
+	}
+
+	// Minimizing sum((y-a*k)^2) gives a = sum(k*y)/sum(k*k), and the
+	// minimum is sum(y*y) - a*sum(k*y).
+	m->amplitude = (kk>0.0) ? ky/kk : 0.0;
+	ss = ids->yy - m->amplitude*ky;
+	if(ss<0.0) ss = 0.0;
+	m->residual = sqrt(ss/ids->num_samples);
+}
+
+static int cmp_match_residual(const void *a, const void *b)
+{
+	double ra = ((const struct rs_match*)a)->residual;
+	double rb = ((const struct rs_match*)b)->residual;
+	if(ra<rb) return -1;
+	if(ra>rb) return 1;
+	return 0;
+}
+
+int rs_identify(const struct rs_result *r, rs_parallel_for_fn pfor,
+	void *pfor_userdata, struct rs_match *matches, int max_matches)
+{
+	struct id_search ids;
+	int i;
+	int retval = 0;
+
+	if(r->num_samples<1 || max_matches<1) return 0;
+	if(!pfor) pfor = serial_for;
+
+	memset(&ids,0,sizeof(struct id_search));
+	ids.num_samples = r->num_samples;
+	ids.x = malloc(sizeof(double)*(size_t)r->num_samples);
+	ids.y = malloc(sizeof(double)*(size_t)r->num_samples);
+	ids.candidates = malloc(sizeof(struct rs_match)*ID_MAX_CANDIDATES);
+	if(!ids.x || !ids.y || !ids.candidates) goto done;
+
+	for(i=0;i<r->num_samples;i++) {
+		ids.x[i] = r->samples[i].x;
+		ids.y[i] = r->samples[i].y;
+		ids.yy += ids.y[i]*ids.y[i];
+	}
+
+	id_make_candidates(&ids);
+	pfor(pfor_userdata,ids.num_candidates,id_eval,&ids);
+	qsort(ids.candidates,ids.num_candidates,sizeof(struct rs_match),cmp_match_residual);
+
+	if(max_matches>ids.num_candidates) max_matches = ids.num_candidates;
+	memcpy(matches,ids.candidates,sizeof(struct rs_match)*(size_t)max_matches);
+	retval = max_matches;
+done:
+	free(ids.x);
+	free(ids.y);
+	free(ids.candidates);
+	return retval;
+}
+
+//////////////////// QUANTIZATION ////////////////////
+
+#define QUANT_MIN_FIT 0.98 // The fraction of weights that must fit
+
+static int cmp_double(const void *a, const void *b)
+{
+	double da = *(const double*)a;
+	double db = *(const double*)b;
+	if(da<db) return -1;
+	if(da>db) return 1;
+	return 0;
+}
+
+// The probability that at least k of n independent events, each with
+// probability p, happen.
+static double binomial_tail(int n, int k, double p)
+{
+	double logc = 0.0; // log(n choose i)
+	double tot = 0.0;
+	int i;
+
+	if(p<=0.0) return (k<=0) ? 1.0 : 0.0;
+	if(p>=1.0) return 1.0;
+	for(i=0;i<=n;i++) {
+		if(i>0) logc += log((double)(n-i+1)/(double)i);
+		if(i>=k) {
+			tot += exp(logc + i*log(p) + (n-i)*log(1.0-p));
+		}
+	}
+	if(tot>1.0) tot = 1.0;
+	return tot;
+}
+
+int rs_lineimg_find_quant(const struct rs_result *r, double step, struct rs_quant *q)
+{
+	double *wts = NULL;
+	double w, v;
+	double tol;
+	double qs; // The quantization step being tested
+	double p;
+	int n = 0;
+	int i, j, bits;
+	int nfit;
+	int retval = 0;
+
+	memset(q,0,sizeof(struct rs_quant));
+	if(r->pattern!=PATTERN_LINEIMG || r->num_samples<1 || step<=0.0) return 0;
+
+	wts = malloc(sizeof(double)*(size_t)r->num_samples);
+	if(!wts) return 0;
+
+	// Undo the scaling done by analyze_lineimg_rows(), to get back to the
+	// weights. The image was rounded to a multiple of 'step', which is
+	// step/200 in weight units, so the true weight is within half of that.
+	tol = 0.5*step/200.0 + 0.000000001;
+	for(i=0;i<r->num_samples;i++) {
+		w = r->samples[i].y;
+		if(r->scale_factor < 1.0) w *= r->scale_factor;
+
+		// Skip samples that may have been clipped, and zero weights, which
+		// would fit any quantization.
+		v = 50.0 + 200.0*w;
+		if(v<step*0.5 || v>255.0-step*0.5) continue;
+		if(fabs(w)<=tol) continue;
+		wts[n++] = fabs(w);
+	}
+
+	// The filter is symmetric, and repeats at each source pixel, so there
+	// are many copies of each weight. Only count the distinct ones.
+	qsort(wts,n,sizeof(double),cmp_double);
+	j = 0;
+	for(i=0;i<n;i++) {
+		if(j>0 && wts[i]-wts[j-1]<0.000001) continue;
+		wts[j++] = wts[i];
+	}
+	n = j;
+	q->num_weights = n;
+	if(n<3) goto done;
+
+	// If the weights are multiples of 2^-bits, they are also multiples of any
+	// smaller power of 2, so look for the fewest bits that fit.
+	for(bits=1;bits<=24;bits++) {
+		qs = 1.0/(double)(1<<bits);
+		// The chance that a weight would fit by accident.
+		p = 2.0*tol/qs;
+		if(p>=0.75) break;
+		q->max_bits = bits;
+		if(q->bits) continue;
+
+		nfit = 0;
+		for(i=0;i<n;i++) {
+			if(fabs(wts[i] - qs*floor(wts[i]/qs+0.5)) <= tol) nfit++;
+		}
+		if(nfit >= QUANT_MIN_FIT*n) {
+			q->bits = bits;
+			q->confidence = 1.0 - binomial_tail(n,nfit,p);
+		}
+	}
+	retval = 1;
+done:
+	free(wts);
+	return retval;
+}
+
+//////////////////// POLYPHASE DETECTION ////////////////////
+
+// If the application snapped each target pixel to one of P phases, the
+// filter was only evaluated at multiples of 1/P source pixels. The samples
+// then form a staircase: within each 1/P-wide bin, they all have the same
+// value. For a filter that was evaluated exactly, the spread within the bins
+// is about the same wherever the bins start. So for each P, we compare the
+// spread with the bins aligned to the grid (or half a bin off, depending on
+// how the application rounded), to the spread with them misaligned.
+
+#define PH_MAX_PHASES 1024
+#define PH_MIN_PER_BIN 2.0 // The fewest samples per bin, on average
+#define PH_MAX_RATIO 0.2
+// A filter that is already piecewise constant, such as a box filter, also
+// makes a staircase, but one with only a few different levels. If it came
+// from snapping a smooth filter to phases, most of the steps (where the
+// filter isn't 0) have a level of their own.
+#define PH_MIN_LEVELS 0.25
+#define PH_MIN_NUM_LEVELS 8
+
+// State for rs_dotimg_find_phases().
+struct ph_search {
+	const struct rs_result *r;
+	double unit; // One source pixel, in the units of the samples' x
+	double xmin, xmax;
+	// The results for P=i+1. The within-bin RMS, with the bins starting at
+	// a multiple of 1/P, and starting half a bin later. -1 = failed.
+	double *rms0;
+	double *rms1;
+	double *per_bin; // The average number of samples per occupied bin
+};
+
+// The sums for each bin of width g, the first of which starts at xmin-g*offset.
+struct ph_bins {
+	int nb;
+	double *sum;
+	double *sumsq;
+	int *count;
+};
+
+static int ph_bin_samples(const struct ph_search *phs, double g, double offset,
+	struct ph_bins *b)
+{
+	const struct rs_sample *smpl;
+	int i, j;
+
+	b->nb = (int)((phs->xmax-phs->xmin)/g + offset) + 2;
+	b->sum = calloc((size_t)b->nb,sizeof(double));
+	b->sumsq = calloc((size_t)b->nb,sizeof(double));
+	b->count = calloc((size_t)b->nb,sizeof(int));
+	if(!b->sum || !b->sumsq || !b->count) return 0;
+
+	for(i=0;i<phs->r->num_samples;i++) {
+		smpl = &phs->r->samples[i];
+		j = (int)floor(smpl->x/g + offset) - (int)floor(phs->xmin/g + offset);
+		if(j<0) j=0;
+		if(j>b->nb-1) j=b->nb-1;
+		b->sum[j] += smpl->y;
+		b->sumsq[j] += smpl->y*smpl->y;
+		b->count[j]++;
+	}
+	return 1;
+}
+
+static void ph_bins_free(struct ph_bins *b)
+{
+	free(b->sum);
+	free(b->sumsq);
+	free(b->count);
+}
+
+// The RMS difference between each sample and the mean of its bin.
+static double ph_within_rms(const struct ph_bins *b, int n, int *occupied)
+{
+	double ss = 0.0;
+	double d;
+	int j;
+
+	*occupied = 0;
+	for(j=0;j<b->nb;j++) {
+		if(b->count[j]<1) continue;
+		(*occupied)++;
+		d = b->sumsq[j] - b->sum[j]*b->sum[j]/b->count[j];
+		if(d>0.0) ss += d;
+	}
+	if(n <= *occupied) return 0.0;
+	return sqrt(ss/(n - *occupied));
+}
+
+static void ph_eval(void *arg, int i)
+{
+	struct ph_search *phs = (struct ph_search*)arg;
+	struct ph_bins b0, b1;
+	double g;
+	int occupied;
+	int n = phs->r->num_samples;
+
+	memset(&b0,0,sizeof(struct ph_bins));
+	memset(&b1,0,sizeof(struct ph_bins));
+	phs->rms0[i] = -1.0;
+	phs->rms1[i] = -1.0;
+	g = phs->unit/(double)(i+1);
+	if(ph_bin_samples(phs,g,0.0,&b0) && ph_bin_samples(phs,g,0.5,&b1)) {
+		phs->rms0[i] = ph_within_rms(&b0,n,&occupied);
+		phs->per_bin[i] = (double)n/occupied;
+		phs->rms1[i] = ph_within_rms(&b1,n,&occupied);
+	}
+	ph_bins_free(&b0);
+	ph_bins_free(&b1);
+}
+
+// Estimates the error caused by snapping to P phases, from the slope of the
+// staircase: a position error spread evenly over a bin of width g gives an
+// RMS error of slope*g/sqrt(12). Also finds the number of different levels
+// among the (nonzero) steps, as a fraction of the number of steps.
+static int ph_snap_error(const struct ph_search *phs, int P, double offset,
+	double *snap_error, double *levels)
+{
+	struct ph_bins b;
+	double *means = NULL;
+	double g, d;
+	double ss = 0.0;
+	int j, n = 0;
+	int nonzero = 0, nlevels = 0;
+	int retval = 0;
+
+	memset(&b,0,sizeof(struct ph_bins));
+	g = phs->unit/(double)P;
+	if(!ph_bin_samples(phs,g,offset,&b)) goto done;
+	means = malloc(sizeof(double)*(size_t)b.nb);
+	if(!means) goto done;
+
+	for(j=0;j<b.nb;j++) {
+		if(b.count[j]<1) continue;
+		if(j+1<b.nb && b.count[j+1]>0) {
+			d = (b.sum[j+1]/b.count[j+1] - b.sum[j]/b.count[j])/g;
+			ss += d*d;
+			n++;
+		}
+		if(fabs(b.sum[j]/b.count[j])>0.01) {
+			means[nonzero++] = b.sum[j]/b.count[j];
+		}
+	}
+	*snap_error = (n>0) ? sqrt(ss/n)*g/sqrt(12.0) : 0.0;
+
+	qsort(means,nonzero,sizeof(double),cmp_double);
+	for(j=0;j<nonzero;j++) {
+		if(j==0 || means[j]-means[j-1]>0.000001) nlevels++;
+	}
+	*levels = (nlevels>=PH_MIN_NUM_LEVELS) ? (double)nlevels/nonzero : 0.0;
+	retval = 1;
+done:
+	ph_bins_free(&b);
+	free(means);
+	return retval;
+}
+
+int rs_dotimg_find_phases(const struct rs_result *r, rs_parallel_for_fn pfor,
+	void *pfor_userdata, struct rs_phases *ph)
+{
+	struct ph_search phs;
+	double lo, hi;
+	double snap_error, levels;
+	int i, P;
+	int retval = 0;
+
+	memset(ph,0,sizeof(struct rs_phases));
+	if(r->pattern!=PATTERN_DOTIMG || r->num_samples<2) return 0;
+	if(!pfor) pfor = serial_for;
+
+	memset(&phs,0,sizeof(struct ph_search));
+	phs.r = r;
+	// When reducing, the samples are in target pixels.
+	phs.unit = (r->scale_factor < 1.0) ? r->scale_factor : 1.0;
+	phs.xmin = phs.xmax = r->samples[0].x;
+	for(i=1;i<r->num_samples;i++) {
+		if(r->samples[i].x<phs.xmin) phs.xmin = r->samples[i].x;
+		if(r->samples[i].x>phs.xmax) phs.xmax = r->samples[i].x;
+	}
+
+	phs.rms0 = malloc(sizeof(double)*PH_MAX_PHASES);
+	phs.rms1 = malloc(sizeof(double)*PH_MAX_PHASES);
+	phs.per_bin = malloc(sizeof(double)*PH_MAX_PHASES);
+	if(!phs.rms0 || !phs.rms1 || !phs.per_bin) goto done;
+
+	pfor(pfor_userdata,PH_MAX_PHASES,ph_eval,&phs);
+
+	// P=1 is no better than evaluating the filter at the nearest source
+	// pixel, so start at 2.
+	for(P=2;P<=PH_MAX_PHASES;P++) {
+		i = P-1;
+		if(phs.rms0[i]<0.0 || phs.rms1[i]<0.0) goto done;
+		if(phs.per_bin[i]<PH_MIN_PER_BIN) break;
+		ph->max_phases = P;
+		if(ph->phases) continue;
+
+		lo = (phs.rms0[i]<phs.rms1[i]) ? phs.rms0[i] : phs.rms1[i];
+		hi = (phs.rms0[i]<phs.rms1[i]) ? phs.rms1[i] : phs.rms0[i];
+		if(hi>0.0 && lo/hi<PH_MAX_RATIO) {
+			if(!ph_snap_error(&phs,P,(phs.rms0[i]<phs.rms1[i])?0.0:0.5,
+				&snap_error,&levels))
+			{
+				goto done;
+			}
+			if(levels<PH_MIN_LEVELS) continue;
+			ph->phases = P;
+			ph->confidence = 1.0 - lo/hi;
+			ph->snap_error = snap_error;
+		}
+	}
+	retval = 1;
+done:
+	free(phs.rms0);
+	free(phs.rms1);
+	free(phs.per_bin);
+	return retval;
+}
+
+//////////////////// KERNEL EXPORT ////////////////////
+
+int rs_kernel_from_result(const struct rs_result *r, double step, struct rs_kernel *k)
+{
+	double *sum = NULL;
+	int *count = NULL;
+	double x, area;
+	int i, j, prev;
+	int retval = 0;
+
+	memset(k,0,sizeof(struct rs_kernel));
+	if(!r->has_support || r->num_samples<1 || step<=0.0) return 0;
+
+	k->step = step;
+	k->n = (int)ceil(r->support/step) + 1;
+	k->radius = (k->n-1)*step;
+	k->v = calloc((size_t)k->n,sizeof(double));
+	sum = calloc((size_t)k->n,sizeof(double));
+	count = calloc((size_t)k->n,sizeof(int));
+	if(!k->v || !sum || !count) goto done;
+
+	// Average the samples in each interval, folding the negative side onto
+	// the positive side.
+	for(i=0;i<r->num_samples;i++) {
+		x = fabs(r->samples[i].x);
+		j = (int)floor(x/step + 0.5);
+		if(j>=k->n) continue;
+		sum[j] += r->samples[i].y;
+		count[j]++;
+	}
+
+	// Fill in any empty intervals by linear interpolation. The last value
+	// is assumed to be 0 if there's nothing beyond it.
+	prev = -1;
+	for(j=0;j<k->n;j++) {
+		if(count[j]<1) continue;
+		k->v[j] = sum[j]/count[j];
+		if(prev<0) {
+			for(i=0;i<j;i++) k->v[i] = k->v[j];
+		}
+		else {
+			for(i=prev+1;i<j;i++) {
+				k->v[i] = k->v[prev] + (k->v[j]-k->v[prev])*(i-prev)/(j-prev);
+			}
+		}
+		prev = j;
+	}
+	if(prev<0) goto done;
+	for(i=prev+1;i<k->n;i++) {
+		k->v[i] = k->v[prev]*(k->n-1-i)/(k->n-1-prev);
+	}
+
+	// Scale to an area of 1 (by the trapezoidal rule, over both sides).
+	area = 0.0;
+	for(j=0;j<k->n;j++) {
+		area += (j==0 || j==k->n-1) ? k->v[j]*0.5 : k->v[j];
+	}
+	area *= 2.0*step;
+	if(area<=0.0) goto done;
+	for(j=0;j<k->n;j++) {
+		k->v[j] /= area;
+	}
+	retval = 1;
+done:
+	free(sum);
+	free(count);
+	return retval;
+}
+
+double rs_kernel_eval(const struct rs_kernel *k, double x)
+{
+	double pos, f;
+	int j;
+
+	pos = fabs(x)/k->step;
+	j = (int)pos;
+	if(j>=k->n-1) return 0.0;
+	f = pos - j;
+	return k->v[j]*(1.0-f) + k->v[j+1]*f;
+}
+
+void rs_kernel_free(struct rs_kernel *k)
+{
+	free(k->v);
+	k->v = NULL;
+}
+
+int rs_kernel_polyphase(const struct rs_kernel *k, double scale, int phases,
+	int frac_bits, struct rs_polyphase *pp)
+{
+	double fscale; // How much the kernel is stretched
+	double phase;
+	double tot, one;
+	double *w;
+	int *q;
+	int p, t, half, biggest;
+	long qtot;
+
+	memset(pp,0,sizeof(struct rs_polyphase));
+	if(scale<=0.0 || phases<1 || frac_bits<0 || frac_bits>30) return 0;
+
+	// As in calc_weights()
+	fscale = (scale<1.0) ? 1.0/scale : 1.0;
+	half = (int)ceil(k->radius*fscale);
+	if(half<1) half = 1;
+	pp->phases = phases;
+	pp->taps = 2*half;
+	pp->first_tap = 1-half;
+	pp->frac_bits = frac_bits;
+
+	pp->w = malloc(sizeof(double)*(size_t)phases*pp->taps);
+	if(!pp->w) return 0;
+	if(frac_bits>0) {
+		pp->q = malloc(sizeof(int)*(size_t)phases*pp->taps);
+		if(!pp->q) return 0;
+	}
+
+	for(p=0;p<phases;p++) {
+		w = &pp->w[(size_t)p*pp->taps];
+		phase = (double)p/(double)phases;
+
+		tot = 0.0;
+		for(t=0;t<pp->taps;t++) {
+			w[t] = rs_kernel_eval(k,((double)(pp->first_tap+t)-phase)/fscale);
+			tot += w[t];
+		}
+		if(tot==0.0) {
+			// Shouldn't happen, but just in case, use the nearest pixel.
+			for(t=0;t<pp->taps;t++) {
+				w[t] = (pp->first_tap+t == ((phase<0.5)?0:1)) ? 1.0 : 0.0;
+			}
+			tot = 1.0;
+		}
+		for(t=0;t<pp->taps;t++) {
+			w[t] /= tot;
+		}
+
+		if(!pp->q) continue;
+
+		// Round to fixed point, then make the weights add up to exactly 1.0
+		// by adjusting the largest one.
+		q = &pp->q[(size_t)p*pp->taps];
+		one = (double)(1L<<frac_bits);
+		qtot = 0;
+		biggest = 0;
+		for(t=0;t<pp->taps;t++) {
+			q[t] = (int)floor(w[t]*one + 0.5);
+			qtot += q[t];
+			if(fabs(w[t])>fabs(w[biggest])) biggest = t;
+		}
+		q[biggest] += (int)((1L<<frac_bits) - qtot);
+	}
+	return 1;
+}
+
+void rs_polyphase_free(struct rs_polyphase *pp)
+{
+	free(pp->w);
+	pp->w = NULL;
+	free(pp->q);
+	pp->q = NULL;
+}
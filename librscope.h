@@ -0,0 +1,449 @@
+// ResampleScope analysis library
+// Copyright (C) 2011-2017 Jason Summers
+
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+// This library generates the test patterns, and analyzes resized copies of
+// them. It does no file I/O and no drawing, and has no global state, so it
+// can be used by multiple threads at once.
+
+#ifndef LIBRSCOPE_H
+#define LIBRSCOPE_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Ideally, DOTIMG_SRC_WIDTH should be a prime number, 2 larger than an easily-typed number.
+#define DOTIMG_SRC_WIDTH    557
+
+// DOTIMG_HPIXELSPAN should be an odd number. Larger numbers make the source image larger,
+// but allow for larger downscaling factors, and filters with larger radii.
+#define DOTIMG_HPIXELSPAN   25
+#define DOTIMG_NUMSTRIPS    DOTIMG_HPIXELSPAN
+#define DOTIMG_HCENTER      ((DOTIMG_HPIXELSPAN-1)/2)
+
+// DOTIMG_STRIPHEIGHT should be an odd number, at least 9 or 11. Larger numbers make the
+// source image larger.
+#define DOTIMG_STRIPHEIGHT  11
+#define DOTIMG_VCENTER      ((DOTIMG_STRIPHEIGHT-1)/2)
+#define DOTIMG_SRC_HEIGHT   (DOTIMG_NUMSTRIPS*DOTIMG_STRIPHEIGHT)
+
+#define DOTIMG_DST_WIDTH    (DOTIMG_SRC_WIDTH-2)
+#define DOTIMG_DST_HEIGHT   DOTIMG_SRC_HEIGHT
+
+
+// LINEIMG_SRC_WIDTH should be an odd number, at least 9 or 11. Larger numbers allow for analysis
+// of filters with larger radii, but may require you to upscale to larger sizes.
+#define LINEIMG_SRC_WIDTH   15
+// LINEIMG_SRC_HEIGHT should be an odd number, big enough to keep the middle rows safe from
+// the effects of the top and bottom edges of the image.
+#define LINEIMG_SRC_HEIGHT  15
+
+// LINEIMG_DST_WIDTH is purely a recommendation to the user, and has no effect on the program.
+// For the smoothest graphs, it should be an odd multiple of LINEIMG_SRC_WIDTH. Ideally, it
+// should be easy to type.
+#define LINEIMG_DST_WIDTH   555
+#define LINEIMG_DST_HEIGHT  LINEIMG_SRC_HEIGHT
+
+
+#define PATTERN_LINEIMG 1
+#define PATTERN_DOTIMG 2
+
+// The transfer function that the application being tested is assumed to
+// have used when resizing in a linear colorspace.
+#define CCMETHOD_LINEAR 0
+#define CCMETHOD_GAMMA  1
+#define CCMETHOD_SRGB   2
+#define CCMETHOD_BT709  3
+
+// Resampling filters, for simulating an application that resizes images.
+#define RS_FILTER_BOX      1
+#define RS_FILTER_TRIANGLE 2
+#define RS_FILTER_CUBIC    3 // The Mitchell-Netravali B,C family
+#define RS_FILTER_LANCZOS  4
+#define RS_FILTER_GAUSSIAN 5
+
+#define RS_ERR_NONE        0
+#define RS_ERR_NOMEM       1
+#define RS_ERR_BADHEIGHT   2 // Dot pattern image is the wrong height
+#define RS_ERR_BADWIDTH    3 // Dot pattern image is too narrow
+#define RS_ERR_TOOSMALL    4 // Line pattern image is too short
+#define RS_ERR_BADSCALE    5 // Scale factor is not a positive number
+
+// A resized image to be analyzed.
+// The samples are in the range 0..255 (approximately), where 50 and 250 are
+// our special "dark" and "light" colors.
+struct rs_image {
+	int w, h;
+	double *pixels; // w*h samples, row-major
+};
+
+struct rs_filter {
+	int type; // RS_FILTER_*
+	double b, c; // For RS_FILTER_CUBIC
+	int lobes; // For RS_FILTER_LANCZOS
+	double sigma; // For RS_FILTER_GAUSSIAN
+};
+
+// The size of the buffer needed by rs_filter_name().
+#define RS_FILTER_NAME_LEN 40
+
+// Settings that affect the analysis of an image.
+struct rs_params {
+	double scale_factor_req;  // The scale factor requested by the user.
+	int scale_factor_req_set;
+	double scale_fudge_factor_req; // Multiply the default scale factor by this fudge factor.
+	int scale_fudge_factor_req_set;
+	// Samples smaller than this (in absolute value) are ignored when finding
+	// the filter's support. The default is RS_DEFAULT_SUPPORT_THRESHOLD.
+	double support_threshold_req;
+	int support_threshold_req_set;
+};
+
+#define RS_DEFAULT_SUPPORT_THRESHOLD 0.01
+
+// One point on the graph of the resampling filter.
+struct rs_sample {
+	// Distance from the center of the filter, in source pixels when
+	// enlarging, or target pixels when reducing.
+	double x;
+	double y; // Value of the filter (1.0 = the full brightness of a pixel)
+	int strip; // For the dot pattern, the strip this came from. Otherwise, 0.
+};
+
+struct rs_result {
+	int pattern; // PATTERN_*
+	int errcode; // RS_ERR_*
+
+	// Size of the image.
+	int w, h;
+
+	// The scale factor (of the image features, not necessarily of the image itself)
+	// that we believe was used when the image was created.
+	double scale_factor;
+
+	// The scale factor based on the number of pixels in the images.
+	double natural_scale_factor;
+
+	// The area under the graph. Only calculated for the line pattern.
+	int has_area;
+	double area;
+
+	// How far the samples are from lying on a single smooth curve: the RMS
+	// difference between the values of samples that are adjacent when
+	// sorted by x. Lower is better. Only calculated for the dot pattern.
+	int has_scatter;
+	double scatter;
+
+	// The support of the filter: the largest distance from the center at which
+	// a sample is not negligible, in the same units as the samples' x.
+	// support_src is the same distance in source pixels, and 'taps' is the
+	// number of source pixels that contribute to each target pixel.
+	int has_support;
+	double support;
+	double support_src;
+	int taps;
+
+	int num_samples;
+	struct rs_sample *samples;
+};
+
+// Pattern generation
+
+// Returns the (unrotated) size of the source image for the given pattern.
+void rs_pattern_size(int pattern, int *w, int *h);
+
+// Writes the source image for the given pattern to 'buf', as 8-bit grayscale
+// samples in row-major order. 'buf' must have room for w*h samples, where
+// w and h are from rs_pattern_size(). If 'rotated' is set, the image is
+// transposed (h*w).
+void rs_gen_pattern(int pattern, int rotated, unsigned char *buf);
+
+// Writes just row 'j' of the source image for the given pattern (transposed,
+// if 'rotated' is set) to 'row', which must have room for one row.
+void rs_gen_pattern_row(int pattern, int rotated, int j, unsigned char *row);
+
+// Resampling
+
+// Sets up 'f' from a name: "box", "triangle", "catmullrom", "mitchell",
+// "bspline", "hermite", "cubic:<B>,<C>", "lanczos" (3 lobes), "lanczos<N>",
+// "gaussian" (sigma=0.5), or "gaussian:<sigma>".
+// Returns 0 if the name isn't recognized.
+int rs_filter_from_name(const char *name, struct rs_filter *f);
+
+// Writes a name for 'f' that rs_filter_from_name() accepts, to 'buf', which
+// must have room for RS_FILTER_NAME_LEN bytes.
+void rs_filter_name(const struct rs_filter *f, char *buf);
+
+// The distance from the center beyond which the filter is 0, at a scale
+// factor of 1.
+double rs_filter_radius(const struct rs_filter *f);
+
+// Evaluates the filter at 'x' source pixels from its center, at a scale
+// factor of 1.
+double rs_filter_eval(const struct rs_filter *f, double x);
+
+// Makes a resized copy of a pattern, the way an application would: the
+// pattern is resized from its normal width to 'dst_width' pixels using
+// filter 'f', and the height is not changed. If 'srgb' is set, the resizing
+// is done in a linear colorspace, assuming the pattern is sRGB.
+// The result is written to 'buf' as 8-bit grayscale samples, in row-major
+// order. 'buf' must have room for dst_width*h samples, where h is from
+// rs_pattern_size(). If 'rotated' is set, the image is transposed
+// (h*dst_width), as if the rotated pattern had been resized vertically.
+// Returns 0 on failure.
+int rs_simulate(int pattern, int rotated, const struct rs_filter *f,
+	int srgb, int dst_width, unsigned char *buf);
+
+// Image decoding
+
+// Fills in tbl[0..255], to convert each possible 8-bit sample in the resized
+// image to the value used by the analyzers. 'gamma' is used with CCMETHOD_GAMMA.
+void rs_make_cc_table(int ccmethod, double gamma, double *tbl);
+
+// Like rs_make_cc_table(), but for 16-bit samples. Fills in tbl[0..65535].
+void rs_make_cc_table16(int ccmethod, double gamma, double *tbl);
+
+// Allocates an image with the given size (after rotation, if any).
+// Returns 0 on failure.
+int rs_image_init(struct rs_image *img, int w, int h);
+
+void rs_image_free(struct rs_image *img);
+
+// Converts row 'y' of a resized image to samples, using the table from
+// rs_make_cc_table(). There are 'bytes_per_pixel' bytes per pixel in 'src',
+// and only the byte at offset 'channel' is used.
+// If 'rotated' is set, the row becomes column 'y' of the image.
+void rs_image_put_row_u8(struct rs_image *img, int rotated, int y,
+	const unsigned char *src, int bytes_per_pixel, int channel,
+	const double *cc_table);
+
+// Analysis
+
+// Guesses which pattern (PATTERN_*) the image was made from.
+int rs_detect_pattern(const struct rs_image *img);
+
+// Analyzes an image made from the given pattern. On success, returns 1, and
+// the result must eventually be freed with rs_result_free(). On failure,
+// returns 0, and sets r->errcode.
+int rs_analyze(const struct rs_image *img, int pattern,
+	const struct rs_params *params, struct rs_result *r);
+
+void rs_result_free(struct rs_result *r);
+
+// A function that calls fn(arg, i) for each i from 0 to n-1, in any order,
+// possibly using multiple threads.
+typedef void (*rs_parallel_for_fn)(void *userdata, int n,
+	void (*fn)(void *arg, int i), void *arg);
+
+// For an image made from the dot pattern, searches for the scale fudge
+// factor (between 1-range and 1+range) that gives the lowest scatter.
+// The candidates are evaluated using 'pfor', which may be NULL.
+// On success, returns 1, and sets *ff and *scatter.
+int rs_dotimg_find_ff(const struct rs_image *img, const struct rs_params *params,
+	double range, rs_parallel_for_fn pfor, void *pfor_userdata,
+	double *ff, double *scatter);
+
+// Streaming analysis
+
+// Collects what the analysis needs from an image that is supplied one row
+// at a time, without keeping the whole image in memory. The rows are in
+// the order they appear in the file, before any rotation.
+struct rs_stream {
+	int pattern; // PATTERN_*, or 0 if not known yet
+	int rotated;
+	int file_w, file_h; // Size of the image in the file
+	int w, h; // Size of the image after rotation
+	int errcode; // RS_ERR_*, if rs_stream_init() failed
+
+	// For the dot pattern: The sums from each strip. NULL if the image can't
+	// be the dot pattern.
+	double *sums;
+
+	// For the line pattern: The three rows in the middle of the image,
+	// starting with row 'scanline'-1. NULL if the image can't be the line
+	// pattern.
+	double *line_rows;
+	int scanline;
+
+	// Set if the top row contains any bright pixels.
+	int top_row_bright;
+
+	// Temporary space for one row of the file.
+	double *row;
+};
+
+// 'pattern' may be 0, in which case enough information is collected to
+// analyze the image as either pattern, and to detect which it is.
+// Returns 0 on failure, and sets s->errcode. In any case, s must eventually
+// be freed with rs_stream_free().
+int rs_stream_init(struct rs_stream *s, int pattern, int rotated,
+	int file_w, int file_h);
+
+// Returns 0 if row 'y' of the file will be ignored, so it doesn't need to
+// be decoded.
+int rs_stream_row_needed(const struct rs_stream *s, int y);
+
+// Adds row 'y' of the file, already converted to file_w samples, in the
+// same range as in rs_image. The rows must be added in order.
+void rs_stream_put_row(struct rs_stream *s, int y, const double *v);
+
+// Like rs_stream_put_row(), for a row in the same format as for
+// rs_image_put_row_u8().
+void rs_stream_put_row_u8(struct rs_stream *s, int y,
+	const unsigned char *src, int bytes_per_pixel, int channel,
+	const double *cc_table);
+
+// Like rs_stream_put_row_u8(), for 16-bit samples, using the table from
+// rs_make_cc_table16().
+void rs_stream_put_row_u16(struct rs_stream *s, int y,
+	const unsigned short *src, int samples_per_pixel, int channel,
+	const double *cc_table);
+
+// Like rs_detect_pattern().
+int rs_stream_detect_pattern(const struct rs_stream *s);
+
+// Like rs_analyze(), after all the rows have been added. If a pattern was
+// given to rs_stream_init(), 'pattern' must be the same.
+int rs_stream_analyze(const struct rs_stream *s, int pattern,
+	const struct rs_params *params, struct rs_result *r);
+
+// Like rs_dotimg_find_ff(), after all the rows have been added.
+int rs_stream_find_ff(const struct rs_stream *s, const struct rs_params *params,
+	double range, rs_parallel_for_fn pfor, void *pfor_userdata,
+	double *ff, double *scatter);
+
+void rs_stream_free(struct rs_stream *s);
+
+// Filter identification
+
+// A known filter, and how well it fits the samples of a result.
+struct rs_match {
+	struct rs_filter filter;
+	double amplitude; // The least-squares fit is amplitude*filter(x).
+	double residual; // RMS difference between the fit and the samples
+};
+
+// Fits the samples in 'r' against a library of known filters, including a
+// range of parameters for the cubic, Lanczos, and Gaussian filters, and
+// writes the best (lowest residual) 'max_matches' of them to 'matches', best
+// first. The candidates are evaluated using 'pfor', which may be NULL.
+// Returns the number of matches written, or 0 on failure.
+int rs_identify(const struct rs_result *r, rs_parallel_for_fn pfor,
+	void *pfor_userdata, struct rs_match *matches, int max_matches);
+
+// Coefficient quantization
+
+struct rs_quant {
+	// The number of fractional bits the filter weights seem to have been
+	// rounded to, or 0 if no quantization was detected.
+	int bits;
+	// For 'bits': 1 minus the probability that the weights of a filter that
+	// wasn't quantized would fit this well by chance.
+	double confidence;
+	// The finest quantization that could be detected, given the precision
+	// of the image.
+	int max_bits;
+	int num_weights; // The number of distinct nonzero weights tested
+};
+
+// For an image made from the line pattern, in which each pixel is 50 plus 200
+// times one filter weight, estimates whether the weights were rounded to
+// fixed point. 'step' is the difference between adjacent sample values in
+// the image, in the range of rs_image: 1 for 8-bit images, 255/65535 for
+// 16-bit images. The image must not have been color corrected.
+// Returns 0 if it can't be done.
+int rs_lineimg_find_quant(const struct rs_result *r, double step, struct rs_quant *q);
+
+// Polyphase detection
+
+struct rs_phases {
+	// The number of filter phases per source pixel that the application
+	// seems to use, or 0 if it doesn't seem to use a fixed number.
+	int phases;
+	// For 'phases': 1 minus the ratio of the spread of the samples within
+	// each phase to the spread when the phases are misaligned.
+	double confidence;
+	// For 'phases': the estimated RMS error in the filter's values, caused by
+	// snapping each target pixel to the nearest phase.
+	double snap_error;
+	// The most phases that could be detected, given the number of samples.
+	int max_phases;
+};
+
+// For an image made from the dot pattern, estimates whether the application
+// used a table of the filter at a fixed number of phases (fractional source
+// pixel positions), instead of evaluating it at the exact position of each
+// target pixel. This only works if r->scale_factor is accurate.
+// The candidates are evaluated using 'pfor', which may be NULL.
+// Returns 0 if it can't be done.
+int rs_dotimg_find_phases(const struct rs_result *r, rs_parallel_for_fn pfor,
+	void *pfor_userdata, struct rs_phases *ph);
+
+// Kernel export
+
+// A filter recovered from the samples of a result, as a table of its values
+// at evenly spaced distances from the center. The filter is assumed to be
+// symmetric, and is scaled to have an area of 1. The distances are in the
+// same units as the samples' x: source pixels when enlarging, target pixels
+// when reducing.
+struct rs_kernel {
+	double radius; // The filter is 0 beyond this
+	double step;
+	int n; // v[i] is the value at distance i*step, up to 'radius'
+	double *v;
+};
+
+// Makes 'k' from the samples within r->support of the center, averaged
+// over intervals of 'step'. Returns 0 on failure. In any case, k must
+// eventually be freed with rs_kernel_free().
+int rs_kernel_from_result(const struct rs_result *r, double step, struct rs_kernel *k);
+
+// Evaluates the kernel by linear interpolation.
+double rs_kernel_eval(const struct rs_kernel *k, double x);
+
+void rs_kernel_free(struct rs_kernel *k);
+
+// The weights for resizing with a kernel at a given scale factor, at a fixed
+// number of phases. For a target pixel whose center is at position c in
+// source pixel coordinates, let i = floor(c), and p = the nearest phase to
+// c-i, so that c-i is close to p/phases. (If p rounds up to 'phases', use
+// i+1 and phase 0.) Then tap t of phase p applies to source pixel
+// i+first_tap+t.
+struct rs_polyphase {
+	int phases;
+	int taps;
+	int first_tap;
+	double *w; // [phases*taps]. The weights of each phase add up to 1.
+	int frac_bits; // 0 if there is no fixed-point table
+	int *q; // [phases*taps]. The same weights, times 2^frac_bits, rounded.
+	        // The weights of each phase add up to exactly 2^frac_bits.
+};
+
+// 'scale' is the number of target pixels per source pixel. 'frac_bits' may be
+// 0, or from 1 to 30. Returns 0 on failure. In any case, pp must eventually
+// be freed with rs_polyphase_free().
+int rs_kernel_polyphase(const struct rs_kernel *k, double scale, int phases,
+	int frac_bits, struct rs_polyphase *pp);
+
+void rs_polyphase_free(struct rs_polyphase *pp);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LIBRSCOPE_H
@@ -0,0 +1,366 @@
+// ResampleScope benchmark
+// Copyright (C) 2011-2017 Jason Summers
+
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+// Times each stage of rscope's processing, on resized patterns made by the
+// built-in resampler, at a range of sizes and filters.
+
+#ifdef _WIN32
+#define RS_WINDOWS
+#endif
+
+#ifdef RS_WINDOWS
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "librscope.h"
+#include "rsgraph.h"
+#include "rspng.h"
+
+#define STAGE_SIMULATE 0 // Making the resized pattern
+#define STAGE_DECODE   1 // Decoding it from a PNG file in memory
+#define STAGE_EXTRACT  2 // Converting the decoded rows to what the analysis needs
+#define STAGE_ANALYZE  3
+#define STAGE_RENDER   4 // Drawing the graph
+#define STAGE_ENCODE   5 // Encoding the graph to a PNG file in memory
+#define NUM_STAGES     6
+
+struct bench_case {
+	int pattern;
+	const char *filter;
+	int width;
+};
+
+static const struct bench_case cases[] = {
+	{ PATTERN_DOTIMG, "box", 350 },
+	{ PATTERN_DOTIMG, "triangle", 555 },
+	{ PATTERN_DOTIMG, "catmullrom", 200 },
+	{ PATTERN_DOTIMG, "catmullrom", 350 },
+	{ PATTERN_DOTIMG, "catmullrom", 555 },
+	{ PATTERN_DOTIMG, "catmullrom", 1100 },
+	{ PATTERN_DOTIMG, "mitchell", 350 },
+	{ PATTERN_DOTIMG, "lanczos3", 350 },
+	{ PATTERN_DOTIMG, "lanczos3", 555 },
+	{ PATTERN_LINEIMG, "box", 555 },
+	{ PATTERN_LINEIMG, "triangle", 555 },
+	{ PATTERN_LINEIMG, "catmullrom", 555 },
+	{ PATTERN_LINEIMG, "mitchell", 555 },
+	{ PATTERN_LINEIMG, "lanczos3", 555 },
+	{ PATTERN_LINEIMG, "lanczos3", 5555 },
+	{ PATTERN_LINEIMG, "lanczos3", 55555 },
+	{ 0, NULL, 0 }
+};
+
+// The cases used with -quick.
+static const struct bench_case quick_cases[] = {
+	{ PATTERN_DOTIMG, "catmullrom", 350 },
+	{ PATTERN_DOTIMG, "lanczos3", 555 },
+	{ PATTERN_LINEIMG, "lanczos3", 555 },
+	{ 0, NULL, 0 }
+};
+
+struct stage_stats {
+	double median;
+	double p95;
+};
+
+static const char *stage_name(int stage)
+{
+	static const char *names[NUM_STAGES] = { "simulate", "decode", "extract",
+		"analyze", "render", "encode" };
+	return names[stage];
+}
+
+// Returns a monotonic time, in seconds.
+#ifdef RS_WINDOWS
+static double timer_now(void)
+{
+	LARGE_INTEGER freq, t;
+	QueryPerformanceFrequency(&freq);
+	QueryPerformanceCounter(&t);
+	return (double)t.QuadPart / (double)freq.QuadPart;
+}
+#else
+static double timer_now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec + (double)ts.tv_nsec/1.0e9;
+}
+#endif
+
+static int cmp_double(const void *a, const void *b)
+{
+	double da = *(const double*)a;
+	double db = *(const double*)b;
+	if(da<db) return -1;
+	if(da>db) return 1;
+	return 0;
+}
+
+// Sorts the times, and calculates the statistics.
+static void calc_stats(double *t, int n, struct stage_stats *st)
+{
+	int k;
+
+	qsort(t,n,sizeof(double),cmp_double);
+	if(n%2)
+		st->median = t[n/2];
+	else
+		st->median = (t[n/2-1]+t[n/2])/2.0;
+
+	// Nearest-rank 95th percentile
+	k = (95*n+99)/100 - 1;
+	if(k<0) k=0;
+	if(k>n-1) k=n-1;
+	st->p95 = t[k];
+}
+
+// Writes an 8-bit image (grayscale if num_colors is 0, otherwise paletted)
+// to a PNG file in memory, the same way rscope does. The caller must free()
+// the result.
+static void *make_png(const unsigned char *buf, int w, int h,
+	const unsigned char (*palette)[3], int num_colors, size_t *size)
+{
+	struct rspngw p;
+	int j;
+	int ok;
+
+	ok = rspngw_open(&p,NULL,w,h,palette,num_colors,RSPNG_DEFAULT_LEVEL);
+	for(j=0; ok && j<h; j++) {
+		ok = rspngw_write_row(&p,&buf[(size_t)j*w]);
+	}
+	if(ok) ok = rspngw_finish(&p);
+	rspngw_close(&p);
+	if(!ok) {
+		free(p.mem);
+		return NULL;
+	}
+	*size = p.mem_size;
+	return p.mem;
+}
+
+// Decodes the PNG file to 'stream', the same way rscope does, and adds the
+// time taken to decode and extract the rows to t_decode and t_extract.
+static int read_png(const void *png_in, size_t png_in_size, int pattern,
+	const double *cc_table, struct rs_stream *stream, double *t_decode, double *t_extract)
+{
+	struct rspng png;
+	unsigned char *row = NULL;
+	double t0;
+	int y;
+	int last_row;
+	int retval = 0;
+
+	t0 = timer_now();
+	if(!rspng_open_mem(&png,png_in,png_in_size)) goto done;
+	*t_decode += timer_now()-t0;
+	if(!rs_stream_init(stream,pattern,0,png.width,png.height)) goto done;
+	row = malloc((size_t)png.width*png.samples_per_pixel);
+	if(!row) goto done;
+
+	last_row = png.height-1;
+	while(last_row>0 && !rs_stream_row_needed(stream,last_row)) {
+		last_row--;
+	}
+
+	for(y=0;y<=last_row;y++) {
+		t0 = timer_now();
+		if(!rspng_read_row(&png,row)) goto done;
+		*t_decode += timer_now()-t0;
+
+		if(!rs_stream_row_needed(stream,y)) continue;
+		t0 = timer_now();
+		rs_stream_put_row_u8(stream,y,row,png.samples_per_pixel,png.channel,cc_table);
+		*t_extract += timer_now()-t0;
+	}
+	retval = 1;
+done:
+	rspng_close(&png);
+	free(row);
+	return retval;
+}
+
+// Runs one case 'iterations' times (plus one untimed warm-up run), and
+// prints the results. Adds the median times to 'totals'.
+// Returns 0 on failure.
+static int run_case(const struct bench_case *bc, int iterations, double *totals)
+{
+	struct rs_filter f;
+	struct rs_params params;
+	struct rs_stream stream;
+	struct rs_result r;
+	struct rs_graph g;
+	struct rsg_style st;
+	struct stage_stats stats;
+	unsigned char *buf = NULL;
+	void *png_in = NULL;
+	void *png_out;
+	size_t png_in_size = 0;
+	size_t png_out_size;
+	double cc_table[256];
+	double *times = NULL;
+	double pixels[NUM_STAGES];
+	double t0, t_decode, t_extract;
+	int src_w, src_h;
+	int w, h;
+	int it, s;
+	char name[100];
+	int retval = 0;
+
+	memset(&stream,0,sizeof(struct rs_stream));
+	memset(&params,0,sizeof(struct rs_params));
+	memset(&g,0,sizeof(struct rs_graph));
+	if(!rs_filter_from_name(bc->filter,&f)) {
+		fprintf(stderr, "Unknown filter: %s\n", bc->filter);
+		goto done;
+	}
+	rs_pattern_size(bc->pattern,&src_w,&src_h);
+	w = bc->width;
+	h = src_h;
+	rs_make_cc_table(CCMETHOD_LINEAR,1.0,cc_table);
+
+	buf = malloc((size_t)w*h);
+	times = calloc((size_t)NUM_STAGES*iterations,sizeof(double));
+	if(!buf || !times) goto done;
+
+	for(s=0;s<NUM_STAGES;s++) {
+		pixels[s] = 0.0;
+	}
+	pixels[STAGE_SIMULATE] = pixels[STAGE_DECODE] = pixels[STAGE_EXTRACT] =
+		pixels[STAGE_ANALYZE] = (double)w*(double)h;
+
+	g.include_logo = 1;
+	sprintf(name, "%s %d", bc->filter, bc->width);
+	st.name = name;
+	st.thicklines = 0;
+	st.color_r = 0; st.color_g = 0; st.color_b = 255;
+
+	for(it= -1; it<iterations; it++) {
+		t0 = timer_now();
+		if(!rs_simulate(bc->pattern,0,&f,0,w,buf)) goto done;
+		if(it>=0) times[STAGE_SIMULATE*iterations+it] = timer_now()-t0;
+
+		if(!png_in) {
+			png_in = make_png(buf,w,h,NULL,0,&png_in_size);
+			if(!png_in) goto done;
+		}
+
+		t_decode = t_extract = 0.0;
+		if(!read_png(png_in,png_in_size,bc->pattern,cc_table,&stream,&t_decode,&t_extract)) goto done;
+		if(it>=0) {
+			times[STAGE_DECODE*iterations+it] = t_decode;
+			times[STAGE_EXTRACT*iterations+it] = t_extract;
+		}
+
+		t0 = timer_now();
+		if(!rs_stream_analyze(&stream,bc->pattern,&params,&r)) goto done;
+		if(it>=0) times[STAGE_ANALYZE*iterations+it] = timer_now()-t0;
+		rs_stream_free(&stream);
+
+		t0 = timer_now();
+		rsg_begin(&g,bc->pattern);
+		if(!g.im) goto done;
+		rsg_plot(&g,&st,&r);
+		if(it>=0) times[STAGE_RENDER*iterations+it] = timer_now()-t0;
+		rs_result_free(&r);
+
+		t0 = timer_now();
+		png_out = make_png(g.im->pixels,g.im->width,g.im->height,
+			g.im->palette,g.im->num_colors,&png_out_size);
+		if(!png_out) goto done;
+		if(it>=0) times[STAGE_ENCODE*iterations+it] = timer_now()-t0;
+		free(png_out);
+		rsg_end(&g);
+	}
+
+	for(s=0;s<NUM_STAGES;s++) {
+		calc_stats(&times[s*iterations],iterations,&stats);
+		totals[s] += stats.median;
+		printf("%-4s %-11s %6d  %-9s %10.4f %10.4f", (bc->pattern==PATTERN_DOTIMG)?"dot":"line",
+			bc->filter, bc->width, stage_name(s), stats.median*1000.0, stats.p95*1000.0);
+		if(pixels[s]>0.0 && stats.median>0.0) {
+			printf(" %10.2f", pixels[s]/stats.median/1.0e6);
+		}
+		printf("\n");
+	}
+
+	retval = 1;
+done:
+	if(!retval) {
+		fprintf(stderr, "Failed: %s %d\n", bc->filter, bc->width);
+	}
+	free(png_in);
+	rs_stream_free(&stream);
+	rsg_end(&g);
+	free(buf);
+	free(times);
+	return retval;
+}
+
+static void usage(void)
+{
+	printf("Usage: rsbench [-n <iterations>] [-quick]\n");
+}
+
+int main(int argc, char **argv)
+{
+	const struct bench_case *bcs = cases;
+	double totals[NUM_STAGES];
+	int iterations = 21;
+	int i, s;
+	int ret = 0;
+
+	for(i=1;i<argc;i++) {
+		if((i<argc-1) && !strcmp(argv[i],"-n")) {
+			iterations = atoi(argv[i+1]);
+			if(iterations<1) {
+				usage();
+				return 1;
+			}
+			i++;
+		}
+		else if(!strcmp(argv[i],"-quick")) {
+			bcs = quick_cases;
+		}
+		else {
+			usage();
+			return 1;
+		}
+	}
+
+	for(s=0;s<NUM_STAGES;s++) {
+		totals[s] = 0.0;
+	}
+
+	printf("ResampleScope benchmark, %d iterations per case\n", iterations);
+	printf("%-4s %-11s %6s  %-9s %10s %10s %10s\n", "", "filter", "width", "stage",
+		"median(ms)", "p95(ms)", "Mpixels/s");
+	for(i=0;bcs[i].filter;i++) {
+		if(!run_case(&bcs[i],iterations,totals)) ret = 1;
+	}
+
+	printf("Total of medians:\n");
+	for(s=0;s<NUM_STAGES;s++) {
+		printf("  %-9s %10.4f ms\n", stage_name(s), totals[s]*1000.0);
+	}
+	return ret;
+}
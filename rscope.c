@@ -34,6 +34,18 @@
 #include <windows.h>
 #include <io.h> // For _setmode
 #include <fcntl.h>
+#else
+#include <pthread.h>
+#include <unistd.h> // For sysconf
+#include <time.h> // For clock_gettime
+#include <sys/resource.h> // For getrusage
+#endif
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <sys/ioctl.h>
+#define RS_PERF_EVENTS
 #endif
 
 #include <stdio.h>
@@ -42,12 +54,9 @@
 #include <string.h>
 #include <math.h>
 
-#ifdef RS_WINDOWS
-#define BGDWIN32 1 // For gd
-#define NONDLL 1 // For gd
-#endif
-#include <gd.h>
-#include <gdfonts.h>
+#include "librscope.h"
+#include "rsgraph.h"
+#include "rsinput.h"
 
 
 #ifdef RS_WINDOWS
@@ -58,104 +67,157 @@
 
 #define RS_VERSION   "1.2"
 
-// Ideally, DOTIMG_SRC_WIDTH should be a prime number, 2 larger than an easily-typed number.
-#define DOTIMG_SRC_WIDTH    557
-
-// DOTIMG_HPIXELSPAN should be an odd number. Larger numbers make the source image larger,
-// but allow for larger downscaling factors, and filters with larger radii.
-#define DOTIMG_HPIXELSPAN   25
-#define DOTIMG_NUMSTRIPS    DOTIMG_HPIXELSPAN
-#define DOTIMG_HCENTER      ((DOTIMG_HPIXELSPAN-1)/2)
-
-// DOTIMG_STRIPHEIGHT should be an odd number, at least 9 or 11. Larger numbers make the
-// source image larger.
-#define DOTIMG_STRIPHEIGHT  11
-#define DOTIMG_VCENTER      ((DOTIMG_STRIPHEIGHT-1)/2)
-#define DOTIMG_SRC_HEIGHT   (DOTIMG_NUMSTRIPS*DOTIMG_STRIPHEIGHT)
-
-#define DOTIMG_DST_WIDTH    (DOTIMG_SRC_WIDTH-2)
-#define DOTIMG_DST_HEIGHT   DOTIMG_SRC_HEIGHT
-
-
-// LINEIMG_SRC_WIDTH should be an odd number, at least 9 or 11. Larger numbers allow for analysis
-// of filters with larger radii, but may require you to upscale to larger sizes.
-#define LINEIMG_SRC_WIDTH   15
-// LINEIMG_SRC_HEIGHT should be an odd number, big enough to keep the middle rows safe from
-// the effects of the top and bottom edges of the image.
-#define LINEIMG_SRC_HEIGHT  15
-
-// LINEIMG_DST_WIDTH is purely a recommendation to the user, and has no effect on the program.
-// For the smoothest graphs, it should be an odd multiple of LINEIMG_SRC_WIDTH. Ideally, it
-// should be easy to type.
-#define LINEIMG_DST_WIDTH   555
-#define LINEIMG_DST_HEIGHT  LINEIMG_SRC_HEIGHT
-
+// Messages saved for later, so that the output from concurrent batch jobs
+// doesn't get mixed up.
+struct msgbuf {
+	char *text;
+	size_t len;
+	size_t alloc;
+};
 
-#define PATTERN_LINEIMG 1
-#define PATTERN_DOTIMG 2
+// Processing stages, for -timing.
+#define STAGE_DECODE   0 // Reading and decoding the PNG file
+#define STAGE_EXTRACT  1 // Converting the decoded image to samples
+#define STAGE_SIMULATE 2 // Making the image, with -simulate
+#define STAGE_ANALYZE  3
+#define STAGE_RENDER   4 // Drawing the graph
+#define STAGE_ENCODE   5 // Encoding and writing the graph's PNG file
+#define NUM_STAGES     6
+
+// Color channels. Normally only the green channel is analyzed.
+#define CHANNEL_R    0
+#define CHANNEL_G    1
+#define CHANNEL_B    2
+#define NUM_CHANNELS 3
+
+// Hardware performance counters, for -timing.
+struct hw_counters {
+	int ok;
+#ifdef RS_PERF_EVENTS
+	int fd_cycles;
+	int fd_instructions;
+#endif
+	double cycles;
+	double instructions;
+};
 
 struct infile_info {
 	const char *fn;
 	const char *name;
-	double scale_factor_req;  // The scale factor requested by the user.
-	int scale_factor_req_set;
-	double scale_fudge_factor_req; // Multiply the default scale factor by this fudge factor.
-	int scale_fudge_factor_req_set;
+	struct rs_params params;
+	int auto_ff; // Search for the best scale fudge factor (-ff auto)
 	int thicklines;
 	int color_r, color_g, color_b;
-#define CCMETHOD_LINEAR 0
-#define CCMETHOD_SRGB   2
-	int color_correction_method;
+	int color_correction_method; // CCMETHOD_*
+	double gamma; // Used with CCMETHOD_GAMMA
+
+	// If 'simulate' is set, the image isn't read from a file. Instead, it's
+	// made by resizing the pattern to sim_width pixels, using sim_filter.
+	int simulate;
+	const char *sim_filter_name;
+	struct rs_filter sim_filter;
+	int sim_width;
+	int sim_srgb;
+	const char *sim_outfn; // If not NULL, also save the simulated image here
+	char sim_desc[100];
 };
 
 struct context {
 	int rotated;
 
-	// Size of the input image.
-	int w, h;
-
-	// The scale factor (of the image features, not necessarily of the image itself)
-	// that we believe was used when the input image was created.
-	double scale_factor;
-
-	// The scale factor based on the number of pixels in the images.
-	double natural_scale_factor;
-
-	gdImagePtr im_in;
 	FILE *im_in_fp;
-
-	// Preferred color to use to for information about the current input image.
-	int curr_color;
-
-	int border_color;
+	// If the input file is standard input, its contents are read into
+	// memory, since it can't be read twice.
+	unsigned char *im_in_data;
+	size_t im_in_size;
+	int stdin_used;
+
+	// How to read input files that have no header (-size, -format).
+	struct rsin_raw raw;
+
+	// Set if -channels rgb was used: analyze the red, green, and blue
+	// channels separately.
+	int channels_rgb;
+
+	// What the analysis needs from each channel (CHANNEL_*) of the input
+	// image, collected as it was decoded. Already transposed if -r was used,
+	// and already color-corrected.
+	struct rs_stream stream[NUM_CHANNELS];
+	int stream_valid;
+	// The color correction settings used to make 'stream'
+	int stream_ccmethod;
+	double stream_gamma;
+	// The difference between adjacent sample values in the image, scaled to
+	// 0..255.
+	double stream_step;
 
 	// Persistent information about each input file.
 	struct infile_info inf[2];
 
-	// Information about the output image coordinates.
-	int gr_width, gr_height;
-	double gr_zero_x, gr_zero_y;
-	double gr_unit_x, gr_unit_y;
-
 	const char *outfn;
-	gdImagePtr im_out;
-
-	// Tracks how many graphs we've plotted on this output image.
-	int graph_count;
-
-	int include_logo;
-	int expandrange;
-
-	// Temporary space for the samples being analyzed.
-	// (Currently only used when with lineimg.)
-	double *samples;
 
-	// Used by the line drawing function
-	int lastpos_set;
-	int lastpos_x, lastpos_y;
-	double lastpos_x_dbl, lastpos_y_dbl;
-
-	double srgb50_as_lin1, srgb_250_as_lin1; // Cached calculated values
+	// The graph being drawn, and the graph settings.
+	struct rs_graph gr;
+
+	// If not NULL, messages are saved here instead of being printed.
+	struct msgbuf *msgs;
+
+	// The format of the output file (OUTFMT_*). If it's not a graph format
+	// (PNG, SVG, or PNM), no graph is drawn.
+#define OUTFMT_PNG  0
+#define OUTFMT_CSV  1
+#define OUTFMT_JSON 2
+#define OUTFMT_BIN  3
+#define OUTFMT_SVG  4
+#define OUTFMT_PNM  5 // Uncompressed PPM graph, or PGM with -gen
+	int output_format;
+
+	// zlib compression level for PNG files, or RSPNG_DEFAULT_LEVEL.
+	int zlevel;
+
+	// If not NULL, also write the raw data to this file.
+	const char *datafn;
+
+	// If not NULL, write the filter to this file as a C header, with
+	// polyphase tables of weights (-export-kernel).
+	const char *kernelfn;
+	int kernel_phases;
+	int kernel_bits; // Fractional bits of the fixed-point weights; 0 = none
+	double kernel_scale; // 0 = the scale factor of the image
+
+	// The number of threads to use for the -ff auto search, and -identify.
+	// 0 = one per processor.
+	int search_nthreads;
+
+	// Set if -timing was used.
+	int timing;
+	double timing_start;
+	double stage_time[NUM_STAGES]; // In seconds
+	double stage_pixels[NUM_STAGES]; // Pixels processed, or 0 if not meaningful
+	struct hw_counters hwc;
+
+	// The analysis results for each input file and channel.
+	struct rs_result res[2][NUM_CHANNELS];
+	int res_valid[2][NUM_CHANNELS];
+
+	// Set if -identify was used: the best matching known filters for each
+	// result.
+	int identify;
+#define IDENTIFY_NUM_MATCHES 5
+	struct rs_match matches[2][NUM_CHANNELS][IDENTIFY_NUM_MATCHES];
+	int num_matches[2][NUM_CHANNELS];
+
+	// Set if -quant was used: the estimated precision of the filter weights
+	// for each result.
+	int find_quant;
+	struct rs_quant quant[2][NUM_CHANNELS];
+	int quant_valid[2][NUM_CHANNELS];
+
+	// Set if -phases was used: the estimated number of filter phases for
+	// each result.
+	int find_phases;
+	struct rs_phases phases[2][NUM_CHANNELS];
+	int phases_valid[2][NUM_CHANNELS];
 };
 
 #ifdef RS_WINDOWS
@@ -216,35 +278,67 @@ static void my_snprintf_win(char *buf, size_t buflen, const char *fmt, ...)
 
 #ifdef RS_WINDOWS
 
-static void printmsg(struct context *c, const char *fmt, ...)
+static void write_msg(const char *s)
 {
-	va_list ap;
-	char buf[500];
-	WCHAR bufW[1000];
-
-	va_start(ap, fmt);
-	_vsnprintf_s(buf, sizeof(buf), _TRUNCATE, fmt, ap);
-	va_end(ap);
+	WCHAR *sW;
 
 	// Convert from UTF-8 to UTF-16
-	MultiByteToWideChar(CP_UTF8, 0,
-		buf, -1,
-		bufW, sizeof(bufW)/sizeof(WCHAR));
-
-	fputws(bufW, stderr);
+	sW = de_utf8_to_utf16_strdup(s);
+	if(!sW) return;
+	fputws(sW, stderr);
+	free(sW);
 }
 
 #else
 
+static void write_msg(const char *s)
+{
+	fputs(s, stderr);
+}
+
+#endif
+
+static void msgbuf_append(struct msgbuf *m, const char *s)
+{
+	size_t n;
+	char *newtext;
+
+	n = strlen(s);
+	if(m->len+n+1 > m->alloc) {
+		m->alloc = 2*(m->len+n+1);
+		newtext = realloc(m->text, m->alloc);
+		if(!newtext) return;
+		m->text = newtext;
+	}
+	memcpy(&m->text[m->len], s, n+1);
+	m->len += n;
+}
+
+static void msgbuf_flush(struct msgbuf *m)
+{
+	if(m->text) write_msg(m->text);
+	free(m->text);
+	memset(m,0,sizeof(struct msgbuf));
+}
+
 static void printmsg(struct context *c, const char *fmt, ...)
 {
 	va_list ap;
+	char buf[500];
+
 	va_start(ap, fmt);
-	vfprintf(stderr, fmt, ap);
+#ifdef RS_WINDOWS
+	_vsnprintf_s(buf, sizeof(buf), _TRUNCATE, fmt, ap);
+#else
+	vsnprintf(buf, sizeof(buf), fmt, ap);
+#endif
 	va_end(ap);
-}
 
-#endif
+	if(c->msgs)
+		msgbuf_append(c->msgs, buf);
+	else
+		write_msg(buf);
+}
 
 #ifdef RS_WINDOWS
 
@@ -278,217 +372,263 @@ static FILE *my_fopen(const char *file, const char *mode)
 
 #endif
 
-static unsigned char unicode_to_latin2_char(unsigned int uchar)
-{
-	size_t i;
-	static const unsigned short latin2table[96] = {
-		0x00A0,0x0104,0x02D8,0x0141,0x00A4,0x013D,0x015A,0x00A7, // 160-167
-		0x00A8,0x0160,0x015E,0x0164,0x0179,0x00AD,0x017D,0x017B, // 168-176
-		0x00B0,0x0105,0x02DB,0x0142,0x00B4,0x013E,0x015B,0x02C7, // ...
-		0x00B8,0x0161,0x015F,0x0165,0x017A,0x02DD,0x017E,0x017C,
-		0x0154,0x00C1,0x00C2,0x0102,0x00C4,0x0139,0x0106,0x00C7,
-		0x010C,0x00C9,0x0118,0x00CB,0x011A,0x00CD,0x00CE,0x010E,
-		0x0110,0x0143,0x0147,0x00D3,0x00D4,0x0150,0x00D6,0x00D7,
-		0x0158,0x016E,0x00DA,0x0170,0x00DC,0x00DD,0x0162,0x00DF,
-		0x0155,0x00E1,0x00E2,0x0103,0x00E4,0x013A,0x0107,0x00E7,
-		0x010D,0x00E9,0x0119,0x00EB,0x011B,0x00ED,0x00EE,0x010F,
-		0x0111,0x0144,0x0148,0x00F3,0x00F4,0x0151,0x00F6,0x00F7,
-		0x0159,0x016F,0x00FA,0x0171,0x00FC,0x00FD,0x0163,0x02D9  // 248-255
-	};
+// The file name "-" means standard input or standard output.
+static int is_stdio_name(const char *fn)
+{
+	return (fn[0]=='-' && fn[1]=='\0');
+}
 
-	for(i=0; i<96; i++) {
-		if((unsigned int)latin2table[i]==uchar) {
-			return (unsigned char)(160+i);
-		}
+// Opens a file for writing, in binary mode. Must be closed with
+// close_output(), which reports whether anything failed to be written.
+static FILE *open_output(const char *fn)
+{
+	if(is_stdio_name(fn)) {
+#ifdef RS_WINDOWS
+		_setmode(_fileno(stdout), _O_BINARY);
+#endif
+		return stdout;
 	}
-	return '?';
+	return my_fopen(fn,"wb");
 }
 
-static void utf8_to_latin2_string(unsigned char *src, unsigned char *dst, size_t dstlen)
+// Returns nonzero if there was a write error, including one that only
+// happened when the buffered data was flushed.
+static int close_output(FILE *w)
 {
-	size_t srcpos, dstpos;
-	unsigned char ch;
-	unsigned int pending_char;
-	int bytes_expected;
+	int err;
 
-	srcpos = 0;
-	dstpos = 0;
-	pending_char = 0;
-	bytes_expected = 0;
+	err = ferror(w);
+	if(w==stdout) {
+		if(fflush(w)) err = 1;
+	}
+	else {
+		if(fclose(w)) err = 1;
+	}
+	return err;
+}
 
-	while(1) {
-		if(dstpos >= dstlen-1) {
-			dst[dstlen-1] = '\0';
-			break;
-		}
+// Reads all of standard input into memory. Returns NULL on failure.
+static unsigned char *read_stdin(size_t *size)
+{
+	unsigned char *data = NULL;
+	unsigned char *newdata;
+	size_t alloc = 0;
+	size_t n;
 
-		ch = src[srcpos++];
+#ifdef RS_WINDOWS
+	_setmode(_fileno(stdin), _O_BINARY);
+#endif
 
-		if(ch<128) { // Only byte of a 1-byte sequence
-			dst[dstpos++] = ch;
-			if(ch=='\0') break;
-		}
-		else if(ch<0xc0) { // Continuation byte
-			if(bytes_expected>0) {
-				pending_char = (pending_char<<6)|(ch&0x3f);
-				bytes_expected--;
-				if(bytes_expected<1) {
-					dst[dstpos++] = unicode_to_latin2_char(pending_char);
-				}
+	*size = 0;
+	while(1) {
+		if(*size==alloc) {
+			alloc = alloc ? 2*alloc : 65536;
+			newdata = realloc(data,alloc);
+			if(!newdata) {
+				free(data);
+				return NULL;
 			}
+			data = newdata;
 		}
-		else if(ch<0xe0) { // 1st byte of a 2-byte sequence
-			pending_char = ch&0x1f;
-			bytes_expected=1;
-		}
-		else if(ch<0xf0) { // 1st byte of a 3-byte sequence
-			pending_char = ch&0x0f;
-			bytes_expected=2;
-		}
-		else if(ch<0xf8) { // 1st byte of a 4-byte sequence
-			pending_char = ch&0x07;
-			bytes_expected=3;
-		}
+		n = fread(&data[*size],1,alloc-*size,stdin);
+		if(n==0) break;
+		*size += n;
 	}
+	return data;
 }
 
-static void my_gdImageString(gdImagePtr im, gdFontPtr f, int x, int y,
-	unsigned char *src_utf8, int color)
+//////////////////// TIMING ////////////////////
+
+// Returns a monotonic time, in seconds.
+#ifdef RS_WINDOWS
+
+static double timer_now(void)
 {
-	unsigned char *src_latin2;
-	size_t src_latin2_len;
+	LARGE_INTEGER freq, t;
+	QueryPerformanceFrequency(&freq);
+	QueryPerformanceCounter(&t);
+	return (double)t.QuadPart / (double)freq.QuadPart;
+}
 
-	src_latin2_len = strlen((const char*)src_utf8) + 1;
-	src_latin2 = malloc(src_latin2_len);
+// Returns the peak memory use of the process in KB, or -1 if unknown.
+static double peak_memory_kb(void)
+{
+	return -1.0;
+}
 
-	// The 'gdFontSmall' font we're using has Latin-2 encoding.
-	// That's not very useful if you're not Eastern European.
-	// TODO: The fix would presumably be to use gd's FreeType features.
-	utf8_to_latin2_string(src_utf8, src_latin2, src_latin2_len);
+#else
 
-	gdImageString(im, f, x, y, src_latin2, color);
-	free(src_latin2);
+static double timer_now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec + (double)ts.tv_nsec/1.0e9;
 }
 
-static void gr_init(struct context *c)
+static double peak_memory_kb(void)
 {
-	c->gr_width = 600;
-	c->gr_zero_x = 230.0;
-	c->gr_unit_x = 90.0;
+	struct rusage ru;
+	if(getrusage(RUSAGE_SELF, &ru)!=0) return -1.0;
+#ifdef __APPLE__
+	return (double)ru.ru_maxrss/1024.0; // bytes
+#else
+	return (double)ru.ru_maxrss; // KB
+#endif
+}
 
-	c->gr_height = 300;
-	if(c->expandrange==2) {
-		c->gr_zero_y = 260.0;
-		c->gr_unit_y = -90.0;
-	}
-	else if(c->expandrange==1) {
-		c->gr_zero_y = 240.0;
-		c->gr_unit_y = -150.0;
-	}
-	else {
-		c->gr_zero_y = 220.0;
-		c->gr_unit_y = -200.0;
-	}
+#endif
 
-	c->im_out =  gdImageCreate(c->gr_width,c->gr_height);
-	gdImageFilledRectangle(c->im_out,0,0,c->gr_width-1,c->gr_height-1,
-	 gdImageColorResolve(c->im_out,255,255,255));
+// Adds the time since t0 to the given stage.
+static void timing_add(struct context *c, int stage, double t0, double npixels)
+{
+	if(!c->timing) return;
+	c->stage_time[stage] += timer_now()-t0;
+	c->stage_pixels[stage] += npixels;
 }
 
-static void gr_done(struct context *c)
+static const char *stage_name(int stage)
 {
-	FILE *w;
-	w = my_fopen(c->outfn,"wb");
-	if(!w) return;
-
-	gdImagePng(c->im_out,w);
-	fclose(w);
-	gdImageDestroy(c->im_out);
+	static const char *names[NUM_STAGES] = { "decode", "extract", "simulate",
+		"analyze", "render", "encode" };
+	return names[stage];
 }
 
-static int point_is_visible(struct context *c, int x, int y)
+#ifdef RS_PERF_EVENTS
+
+static int perf_open_counter(unsigned long long config)
 {
-	if(x<0 || y<0) return 0;
-	if(x>=c->gr_width || y>=c->gr_height) return 0;
-	return 1;
+	struct perf_event_attr pea;
+
+	memset(&pea,0,sizeof(struct perf_event_attr));
+	pea.type = PERF_TYPE_HARDWARE;
+	pea.size = sizeof(struct perf_event_attr);
+	pea.config = config;
+	pea.disabled = 1;
+	pea.inherit = 1; // Include the -ff auto worker threads
+	pea.exclude_kernel = 1;
+	pea.exclude_hv = 1;
+	return (int)syscall(__NR_perf_event_open, &pea, 0, -1, -1, 0);
 }
 
-// Convert from logical coordinates to output-image coordinates.
-static int xcoord(struct context *c, double ix)
+// Starts counting CPU cycles and instructions for this thread, if the
+// system allows it.
+static void hwc_start(struct hw_counters *h)
 {
-	double physx;
-	physx = c->gr_zero_x + (ix*c->gr_unit_x);
-	return (int)(0.5+physx);
+	memset(h,0,sizeof(struct hw_counters));
+	h->fd_cycles = perf_open_counter(PERF_COUNT_HW_CPU_CYCLES);
+	h->fd_instructions = perf_open_counter(PERF_COUNT_HW_INSTRUCTIONS);
+	if(h->fd_cycles<0 || h->fd_instructions<0) {
+		if(h->fd_cycles>=0) close(h->fd_cycles);
+		if(h->fd_instructions>=0) close(h->fd_instructions);
+		return;
+	}
+	ioctl(h->fd_cycles, PERF_EVENT_IOC_RESET, 0);
+	ioctl(h->fd_instructions, PERF_EVENT_IOC_RESET, 0);
+	ioctl(h->fd_cycles, PERF_EVENT_IOC_ENABLE, 0);
+	ioctl(h->fd_instructions, PERF_EVENT_IOC_ENABLE, 0);
+	h->ok = 1;
 }
-static int ycoord(struct context *c, double iy)
+
+// Reads the counters (they keep running).
+static void hwc_read(struct hw_counters *h)
 {
-	double physy;
-	physy = c->gr_zero_y + (iy*c->gr_unit_y);
-	return (int)(0.5+physy);
+	unsigned long long v;
+
+	if(!h->ok) return;
+	if(read(h->fd_cycles, &v, sizeof(v))==(ssize_t)sizeof(v))
+		h->cycles = (double)v;
+	if(read(h->fd_instructions, &v, sizeof(v))==(ssize_t)sizeof(v))
+		h->instructions = (double)v;
 }
 
-static void gr_draw_grid(struct context *c)
+static void hwc_stop(struct hw_counters *h)
 {
-	int clr;
-	int i;
-	char tbuf[20];
+	if(!h->ok) return;
+	close(h->fd_cycles);
+	close(h->fd_instructions);
+	h->ok = 0;
+}
 
-	clr = gdImageColorResolve(c->im_out,192,192,192);
-	for(i= -10; i<=10; i++) {
-		// Draw lines for half-integers
-		gdImageDashedLine(c->im_out,xcoord(c,0.5+(double)i),0,xcoord(c,0.5+(double)i),c->gr_height,clr);
-		gdImageDashedLine(c->im_out,0,ycoord(c,0.5+(double)i),c->gr_width,ycoord(c,0.5+(double)i),clr);
-	}
+#else
 
-	// Draw lines for integers
-	clr = gdImageColorResolve(c->im_out,192,192,192);
-	for(i= -10; i<=10; i++) {
-		gdImageLine(c->im_out,xcoord(c,i),0,xcoord(c,i),c->gr_height,clr);
-		gdImageLine(c->im_out,0,ycoord(c,i),c->gr_width,ycoord(c,i),clr);
+static void hwc_start(struct hw_counters *h)
+{
+	memset(h,0,sizeof(struct hw_counters));
+}
 
-	}
+static void hwc_read(struct hw_counters *h) { }
+static void hwc_stop(struct hw_counters *h) { }
+
+#endif
 
-	// Draw x- and y- axes
-	clr = gdImageColorResolve(c->im_out,0,0,0);
-	gdImageLine(c->im_out,xcoord(c,0.0),0,xcoord(c,0.0),c->gr_height,clr);
-	gdImageLine(c->im_out,0,ycoord(c,0.0),c->gr_width,ycoord(c,0.0),clr);
+static void timing_begin(struct context *c)
+{
+	int i;
 
-	// Draw labels
-	clr = gdImageColorResolve(c->im_out,0,128,0);
-	for(i= 0; i<=1; i++) {
-		my_snprintf(tbuf, sizeof(tbuf), "%d", i);
-		my_gdImageString(c->im_out,gdFontSmall,xcoord(c,i)-6,c->gr_height-14,
-			(unsigned char*)tbuf,clr);
-		my_gdImageString(c->im_out,gdFontSmall,3,ycoord(c,i)-12,
-			(unsigned char*)tbuf,clr);
+	if(!c->timing) return;
+	for(i=0;i<NUM_STAGES;i++) {
+		c->stage_time[i] = 0.0;
+		c->stage_pixels[i] = 0.0;
 	}
-
-	// Draw border around the whole image
-	gdImageRectangle(c->im_out,0,0,c->gr_width-1,c->gr_height-1,c->border_color);
+	hwc_start(&c->hwc);
+	c->timing_start = timer_now();
 }
 
-static void gr_lineto(struct context *c, double xpos1, double ypos1, int clr)
+static void print_timing(struct context *c)
 {
-	int xpos, ypos;
-
-	xpos = xcoord(c,xpos1);
-	ypos = ycoord(c,ypos1);
+	int i;
+	double kb;
+
+	if(!c->timing) return;
+	hwc_read(&c->hwc);
+
+	printmsg(c, " Timing:\n");
+	for(i=0;i<NUM_STAGES;i++) {
+		if(c->stage_time[i]==0.0) continue;
+		printmsg(c, "  %-9s %10.6f s", stage_name(i), c->stage_time[i]);
+		if(c->stage_pixels[i]>0.0) {
+			printmsg(c, "  %10.3f Mpixels/s",
+				c->stage_pixels[i]/c->stage_time[i]/1.0e6);
+		}
+		printmsg(c, "\n");
+	}
+	printmsg(c, "  %-9s %10.6f s\n", "total", timer_now()-c->timing_start);
 
-	if(c->lastpos_set) {
-		gdImageLine(c->im_out,c->lastpos_x,c->lastpos_y,xpos,ypos,clr);
+	kb = peak_memory_kb();
+	if(kb>=0.0) {
+		printmsg(c, "  Peak memory: %.0f KB\n", kb);
 	}
+	if(c->hwc.ok) {
+		printmsg(c, "  Cycles: %.0f, instructions: %.0f", c->hwc.cycles, c->hwc.instructions);
+		if(c->hwc.cycles>0.0) {
+			printmsg(c, " (%.2f per cycle)", c->hwc.instructions/c->hwc.cycles);
+		}
+		printmsg(c, "\n");
+	}
+	else {
+		printmsg(c, "  Hardware counters: not available\n");
+	}
+}
 
-	c->lastpos_x = xpos;
-	c->lastpos_y = ypos;
-	c->lastpos_x_dbl = xpos1;
-	c->lastpos_y_dbl = ypos1;
-	c->lastpos_set=1;
+static void timing_end(struct context *c, int report)
+{
+	if(!c->timing) return;
+	if(report) print_timing(c);
+	hwc_stop(&c->hwc);
 }
 
+///////////////////////////////////////////////
+
 // Heuristically figure out a friendly name to use for the graph.
 static void gr_get_name_from_fn(const char *fn, char *buf, size_t buflen)
 {
 	char *r;
+
+	if(is_stdio_name(fn)) {
+		my_snprintf(buf, buflen, "stdin");
+		return;
+	}
+
 	r = strrchr(fn,'/');
 #ifdef RS_WINDOWS
 	if(!r) r = strrchr(fn,'\\');
@@ -505,425 +645,1434 @@ static void gr_get_name_from_fn(const char *fn, char *buf, size_t buflen)
 	}
 }
 
-static void gr_draw_graph_name(struct context *c, struct infile_info *inf, int sf_flag)
-{
-	int ypos;
-	char buf[100];
-	char s[100];
-
-	ypos = c->gr_height-19-14*c->graph_count;
+// Writes an image with 8-bit samples, one row at a time, to a PNG file, or
+// to an uncompressed PGM (grayscale) or PPM (paletted) file.
+struct image_writer {
+	int pnm;
+	FILE *w;
+	const char *fn;
+	int width;
+	const unsigned char (*palette)[3];
+	int num_colors; // 0 = grayscale
+	unsigned char *rgbrow; // For PPM files
+	struct rspngw png;
+};
 
-	if(inf->name) {
-		my_snprintf(buf, sizeof(buf), "%s", inf->name);
+static int iw_open(struct context *c, struct image_writer *iw, const char *fn,
+	int pnm, int width, int height, const unsigned char (*palette)[3], int num_colors)
+{
+	memset(iw,0,sizeof(struct image_writer));
+	iw->pnm = pnm;
+	iw->fn = fn;
+	iw->width = width;
+	iw->palette = palette;
+	iw->num_colors = num_colors;
+
+	iw->w = open_output(fn);
+	if(!iw->w) {
+		printmsg(c, "* Error: Failed to write %s\n",fn);
+		return 0;
 	}
-	else {
-		gr_get_name_from_fn(inf->fn,buf,100);
-	}
-	if(inf->thicklines) gdImageSetThickness(c->im_out,3);
-	gdImageLine(c->im_out,5,ypos+7,13,ypos+7,c->curr_color);
-	gdImageSetThickness(c->im_out,1);
-
-	my_snprintf(s, sizeof(s), "%s", buf);
-	if(sf_flag) {
-		double ff;
-		ff = c->scale_factor / c->natural_scale_factor;
-		if(ff<0.99999999 || ff>1.00000001) {
-			my_snprintf(s, sizeof(s), "%s (factor=%.8f)", buf, ff);
+
+	if(pnm) {
+		if(num_colors>0) {
+			iw->rgbrow = malloc((size_t)width*3);
+			if(!iw->rgbrow) {
+				printmsg(c, "* Error: Out of memory\n");
+				return 0;
+			}
 		}
+		fprintf(iw->w, "P%d\n%d %d\n255\n", (num_colors>0)?6:5, width, height);
+		return 1;
 	}
 
-	s[sizeof(s)-1]='\0';
-	my_gdImageString(c->im_out,gdFontSmall,17,ypos,(unsigned char*)s,c->curr_color);
+	if(!rspngw_open(&iw->png,iw->w,width,height,palette,num_colors,c->zlevel)) {
+		printmsg(c, "* Error: Failed to write %s: %s\n",fn,iw->png.errmsg);
+		return 0;
+	}
+	return 1;
 }
 
-static void gr_draw_logo(struct context *c)
+static int iw_write_row(struct context *c, struct image_writer *iw,
+	const unsigned char *row)
 {
-	if(!c->include_logo) return;
-
-	gdImageFilledRectangle(c->im_out,c->gr_width-81,c->gr_height-15,
-	 c->gr_width-1,c->gr_height-1,c->border_color);
-
-	my_gdImageString(c->im_out,gdFontSmall,c->gr_width-79,c->gr_height-15,
-		(unsigned char*)"ResampleScope",
-		gdImageColorResolve(c->im_out,255,255,255));
-}
-
-/////////////////////////////////////////////////
+	int i;
 
-// Wrappers for gd functions, which swap the x and y coordinates if -r was used,
-// and may do colorspace transformation.
+	if(!iw->pnm) {
+		if(!rspngw_write_row(&iw->png,row)) {
+			printmsg(c, "* Error: Failed to write %s: %s\n",iw->fn,iw->png.errmsg);
+			return 0;
+		}
+		return 1;
+	}
 
-static void rs_gdImageSetPixel(struct context *c, gdImagePtr im, int x, int y, int color)
-{
-	if(c->rotated)
-		gdImageSetPixel(im,y,x,color);
-	else
-		gdImageSetPixel(im,x,y,color);
+	if(iw->num_colors>0) {
+		for(i=0;i<iw->width;i++) {
+			memcpy(&iw->rgbrow[3*i],iw->palette[row[i]],3);
+		}
+		row = iw->rgbrow;
+	}
+	fwrite(row,1,(size_t)iw->width*((iw->num_colors>0)?3:1),iw->w);
+	return 1;
 }
 
-static double srgb_to_linear(double v_srgb)
+// Finishes the file if 'ok' is set, and frees everything.
+static int iw_close(struct context *c, struct image_writer *iw, int ok)
 {
-	if(v_srgb<=0.04045) {
-		return v_srgb/12.92;
+	if(ok && !iw->pnm) {
+		if(!rspngw_finish(&iw->png)) {
+			printmsg(c, "* Error: Failed to write %s: %s\n",iw->fn,iw->png.errmsg);
+			ok = 0;
+		}
 	}
-	else {
-		return pow( (v_srgb+0.055)/(1.055) , 2.4);
+	if(!iw->pnm) rspngw_close(&iw->png);
+	if(iw->w && close_output(iw->w) && ok) {
+		printmsg(c, "* Error: Failed to write %s\n",iw->fn);
+		ok = 0;
 	}
+	free(iw->rgbrow);
+	return ok;
 }
 
-// Returns a value typically in the range 0..255,
-// where 50 and 250 are our special "dark" and "light" colors.
-static double rs_gdImageGetPixel(struct context *c, struct infile_info *inf,
-	gdImagePtr im, int x, int y)
+// Writes the graph to c->outfn, and destroys it.
+static int gr_done(struct context *c)
 {
-	int colorref;
-	double val;
+	FILE *w;
+	struct image_writer iw;
+	const struct rsr_image *im;
+	const char *svg;
+	size_t svg_len = 0;
+	double t0;
+	int j;
+	int ok;
+	int retval=0;
 
-	if(c->rotated)
-		colorref = gdImageGetPixel(im,y,x);
-	else
-		colorref = gdImageGetPixel(im,x,y);
+	if(!rsg_is_drawing(&c->gr)) {
+		printmsg(c, "* Error: Out of memory\n");
+		goto done;
+	}
 
-	val = (double)gdImageGreen(im, colorref);
+	t0 = timer_now();
+	if(c->gr.svg) {
+		svg = rsg_finish_svg(&c->gr,&svg_len);
+		if(!svg) {
+			printmsg(c, "* Error: Out of memory\n");
+			goto done;
+		}
 
-	if(inf->color_correction_method==CCMETHOD_SRGB) {
-		double v1;
-		// We're assuming the app being tested behaved as follows:
-		// (1) converted the original colors from sRGB to linear;
-		// (2) resized the image in a linear colorspace;
-		// (3) converted back to sRGB.
+		w = open_output(c->outfn);
+		if(!w) {
+			printmsg(c, "* Error: Failed to write %s\n",c->outfn);
+			goto done;
+		}
+		ok = (fwrite(svg,1,svg_len,w)==svg_len);
+		if(close_output(w)) ok = 0;
+		if(!ok) {
+			printmsg(c, "* Error: Failed to write %s\n",c->outfn);
+			goto done;
+		}
+	}
+	else {
+		im = c->gr.im;
+		ok = iw_open(c,&iw,c->outfn,c->output_format==OUTFMT_PNM,
+			im->width,im->height,im->palette,im->num_colors);
+		for(j=0; ok && j<im->height; j++) {
+			ok = iw_write_row(c,&iw,&im->pixels[(size_t)j*im->width]);
+		}
+		if(!iw_close(c,&iw,ok)) goto done;
+	}
+	timing_add(c,STAGE_ENCODE,t0,0.0);
+	retval=1;
+done:
+	rsg_end(&c->gr);
+	return retval;
+}
 
-		// First, undo (3) by converting from sRGB[0..255] to linear[0..1].
-		v1 = srgb_to_linear((double)val/255.0);
+/////////////////////////////////////////////////
 
-		// The catch is that the color is now in that app's linear colorspace,
-		// not ours.
-		// If we were to simply multiply the value by 255, our dark color would
-		// correspond to ~8.1, and our light color to ~243.7.
-		// That's not what we want. We want 50 and 250.
-		// So, we have to be careful to scale and translate it to the correct
-		// range.
-		val = (v1-c->srgb50_as_lin1) *
-			((250.0-50.0)/(c->srgb_250_as_lin1-c->srgb50_as_lin1)) + 50.0;
-	}
+// Returns nonzero if the file name has an extension for a PNM file.
+static int is_pnm_fn(const char *fn)
+{
+	const char *ext;
 
-	return val;
+	ext = strrchr(fn,'.');
+	if(!ext) return 0;
+	return !strcmp(ext,".pgm") || !strcmp(ext,".ppm") || !strcmp(ext,".pnm");
 }
 
-static int rs_gdImageSX(struct context *c, gdImagePtr im)
+// Writes 8-bit grayscale samples to a PNG file, or a PGM file if fn has a
+// PNM extension.
+static int write_gray_image(struct context *c, const unsigned char *buf,
+	int width, int height, const char *fn)
 {
-	return c->rotated ? gdImageSY(im) : gdImageSX(im);
+	struct image_writer iw;
+	int j;
+	int ok;
+
+	ok = iw_open(c,&iw,fn,is_pnm_fn(fn),width,height,NULL,0);
+	for(j=0; ok && j<height; j++) {
+		ok = iw_write_row(c,&iw,&buf[(size_t)j*width]);
+	}
+	return iw_close(c,&iw,ok);
 }
 
-static int rs_gdImageSY(struct context *c, gdImagePtr im)
+// Prints an error message for a failed analysis. w and h are the size of
+// the image, after rotation.
+static void print_analysis_error(struct context *c, int errcode, int w, int h)
 {
-	return c->rotated ? gdImageSX(im) : gdImageSY(im);
+	switch(errcode) {
+	case RS_ERR_NOMEM:
+		printmsg(c, "* Error: Out of memory\n");
+		break;
+	case RS_ERR_BADHEIGHT:
+		printmsg(c, "* Error: Image is wrong height (is %d, should be %d)\n",h,DOTIMG_SRC_HEIGHT);
+		break;
+	case RS_ERR_BADWIDTH:
+		printmsg(c, "* Error: Image is wrong width (is %d, must be at least 50)\n",w);
+		break;
+	case RS_ERR_TOOSMALL:
+		printmsg(c, "Image height (%d) too small\n",h);
+		break;
+	case RS_ERR_BADSCALE:
+		printmsg(c, "* Error: Invalid scale factor\n");
+		break;
+	default:
+		printmsg(c, "* Error: Analysis failed\n");
+	}
 }
 
-/////////////////////////////////////////////////
-
-// Opens and reads the image, if that hasn't already been done.
+// Opens the input file, if that hasn't already been done.
 static int open_file_for_reading(struct context *c, const char *fn)
 {
 	// The file may have already been opened, to detect the image type.
 	// If not, open it now.
-	if(!c->im_in_fp) {
-		c->im_in_fp = my_fopen(fn,"rb");
-		if(!c->im_in_fp) {
-			printmsg(c, "* Error: Failed to read %s\n",fn);
+	if(is_stdio_name(fn)) {
+		if(c->im_in_data) return 1;
+		if(c->stdin_used) {
+			printmsg(c, "* Error: Standard input can only be read once\n");
+			return 0;
+		}
+		c->stdin_used = 1;
+		c->im_in_data = read_stdin(&c->im_in_size);
+		if(!c->im_in_data) {
+			printmsg(c, "* Error: Failed to read standard input\n");
 			return 0;
 		}
+		return 1;
 	}
 
-	if(!c->im_in) {
-		c->im_in = gdImageCreateFromPng(c->im_in_fp);
-		if(!c->im_in) {
-			printmsg(c, "gd creation failed\n");
+	if(!c->im_in_fp) {
+		c->im_in_fp = my_fopen(fn,"rb");
+		if(!c->im_in_fp) {
+			printmsg(c, "* Error: Failed to read %s\n",fn);
 			return 0;
 		}
 	}
-
 	return 1;
 }
 
-static void close_file_for_reading(struct context *c)
+static int channel_used(struct context *c, int ch)
 {
-	if(c->im_in) { gdImageDestroy(c->im_in); c->im_in = NULL; }
-	if(c->im_in_fp) { fclose(c->im_in_fp); c->im_in_fp = NULL; }
+	return c->channels_rgb || ch==CHANNEL_G;
 }
 
-//////////////////// DOTIMG ////////////////////
+static const char *channel_name(int ch)
+{
+	static const char *names[NUM_CHANNELS] = { "R", "G", "B" };
+	return names[ch];
+}
 
-// Plot values for pixels the given "strip".
-// The first DOTIMG_STRIPHEIGHT scalines are strip 0,
-//    the next DOTIMG_STRIPHEIGHT are strip 1, etc.
-static int plot_strip(struct context *c, struct infile_info *inf, int stripnum)
+static void free_streams(struct context *c)
 {
-	double v;
-	int dstpos,k;
-	double tot;
-	double value;
-	int xc,yc;
-	double zp;
-	double tmp_offset;
-	double offset; // Relative position of the nearest "0" point, in target image coords.
+	int ch;
 
-	for(dstpos=0;dstpos<c->w;dstpos++) {
+	for(ch=0;ch<NUM_CHANNELS;ch++) {
+		rs_stream_free(&c->stream[ch]);
+	}
+	c->stream_valid = 0;
+}
 
-		// Scan through the possible "0" points in this strip, and find the nearest one.
-		offset = 10000.0; // (too far)
+// Sets up c->stream for an image of the given size, as it is in the file.
+// On failure, prints an error message and returns 0.
+static int init_streams(struct context *c, struct infile_info *inf, int pattern,
+	int file_w, int file_h)
+{
+	int ch;
+
+	memset(c->stream,0,sizeof(c->stream));
+	for(ch=0;ch<NUM_CHANNELS;ch++) {
+		if(!channel_used(c,ch)) continue;
+		if(!rs_stream_init(&c->stream[ch], pattern, c->rotated, file_w, file_h)) {
+			print_analysis_error(c,c->stream[ch].errcode,c->stream[ch].w,c->stream[ch].h);
+			free_streams(c);
+			return 0;
+		}
+	}
+	c->stream_valid = 1;
+	c->stream_ccmethod = inf->color_correction_method;
+	c->stream_gamma = inf->gamma;
+	return 1;
+}
 
-		// There are "0" points at ({5,16,27,38...}+stripnum) * scale_factor
+// Decodes the input file 'fn' to c->stream, if that hasn't already been done
+// with the same settings. 'pattern' is 0 if it isn't known yet.
+// The rows are decoded one at a time, and only the information the analysis
+// needs is kept, so even a huge image doesn't use much memory.
+static int decode_image(struct context *c, const char *fn, struct infile_info *inf,
+	int pattern)
+{
+	struct rsinput in;
+	void *row = NULL;
+	double *cc_table = NULL;
+	double t0;
+	int y;
+	int ch, offset;
+	int last_row;
+	int retval=0;
 
-		for(k=(DOTIMG_HCENTER+stripnum); k<(DOTIMG_SRC_WIDTH-DOTIMG_HCENTER); k+=DOTIMG_HPIXELSPAN) {
-			// Convert to target image coordinates.
+	if(c->stream_valid) {
+		if(c->stream_ccmethod==inf->color_correction_method &&
+			c->stream_gamma==inf->gamma &&
+			(c->stream[CHANNEL_G].pattern==0 || c->stream[CHANNEL_G].pattern==pattern))
+		{
+			return 1;
+		}
+		free_streams(c);
+	}
 
-			// I don't really remember why this formula works, but it seems to.
-			zp = (c->scale_factor)*(((double)k) + 0.5 - ((double)DOTIMG_SRC_WIDTH)/2.0) + (c->w/2.0)  - 0.5;
+	t0 = timer_now();
+	if(!rsin_open(&in, c->im_in_data?NULL:c->im_in_fp, c->im_in_data, c->im_in_size,
+		&c->raw))
+	{
+		printmsg(c, "* Error: Failed to decode %s: %s\n",fn,in.errmsg);
+		goto done;
+	}
+	timing_add(c,STAGE_DECODE,t0,0.0);
 
-			// The directed distance to this 0 point.
-			tmp_offset = ((double)dstpos)-zp;
+	// If the pattern is known, this rejects an image of the wrong size
+	// before any pixels are decoded.
+	if(!init_streams(c, inf, pattern, in.width, in.height)) goto done;
+	c->stream_step = 255.0/in.maxval;
 
-			// Keep track of the smallest (in absolute value) distance.
-			if(fabs(tmp_offset)<fabs(offset)) {
-				offset = tmp_offset;
-			}
-		}
+	row = malloc((size_t)in.width*in.samples_per_pixel*(in.bit_depth/8));
+	cc_table = malloc(sizeof(double)*((in.bit_depth==16)?65536:256));
+	if(!row || !cc_table) {
+		printmsg(c, "* Error: Out of memory\n");
+		goto done;
+	}
 
-		// Make sure the offset is small enough to be meaningful
-		// TODO: This might only be correct when downscaling.
-		if(fabs(offset)>(c->scale_factor*DOTIMG_HCENTER)) continue;
-
-		// Add up the DOTIMG_STRIPHEIGHT pixels vertically that are in this strip.
-		// Ideally, all but the middle one will be empty, but in reality most
-		// filters get applied vertically as well as horizontally, which can 
-		// cause vertical blurring depending on the filter. This is how we
-		// undo that.
-		tot = 0;
-		for(k=0;k<DOTIMG_STRIPHEIGHT;k++) {
-			v = rs_gdImageGetPixel(c, inf, c->im_in,
-				dstpos, DOTIMG_STRIPHEIGHT*stripnum+k);
-			tot += (v-50.0);
-		}
+	if(in.bit_depth==16)
+		rs_make_cc_table16(inf->color_correction_method, inf->gamma, cc_table);
+	else
+		rs_make_cc_table(inf->color_correction_method, inf->gamma, cc_table);
 
-		// Convert (0 to 200) to (0 to 1).
-		value = tot/200.0;
+	// There's no need to read past the last row we need.
+	last_row = in.height-1;
+	while(last_row>0 && !rs_stream_row_needed(&c->stream[CHANNEL_G],last_row)) {
+		last_row--;
+	}
 
-		if(c->scale_factor < 1.0) {
-			// Compensate for the fact that we're shrinking the image, which
-			// reduces the size of a pixel, making it dimmer.
-			// This factor is normally about 0.996, so this will only make
-			// a small difference.
-			value /= c->scale_factor;
+	for(y=0;y<=last_row;y++) {
+		t0 = timer_now();
+		if(!rs_stream_row_needed(&c->stream[CHANNEL_G],y)) {
+			if(!rsin_skip_row(&in)) goto readerr;
+			timing_add(c,STAGE_DECODE,t0,(double)in.width);
+			continue;
 		}
-		else {
-			offset /= c->scale_factor;
-		}
-
-		// Plot the point.
-		xc = xcoord(c,offset);
-		yc = ycoord(c,value);
-		if(point_is_visible(c,xc,yc)) {
-			gdImageSetPixel(c->im_out,xc,yc,c->curr_color);
-			if(inf->thicklines) {
-				gdImageSetPixel(c->im_out,xc-1,yc,c->curr_color);
-				gdImageSetPixel(c->im_out,xc+1,yc,c->curr_color);
-				gdImageSetPixel(c->im_out,xc,yc-1,c->curr_color);
-				gdImageSetPixel(c->im_out,xc,yc+1,c->curr_color);
+		if(!rsin_read_row(&in,row)) goto readerr;
+		timing_add(c,STAGE_DECODE,t0,(double)in.width);
+
+		t0 = timer_now();
+		for(ch=0;ch<NUM_CHANNELS;ch++) {
+			if(!channel_used(c,ch)) continue;
+			// Grayscale images have only one channel to use.
+			offset = (in.samples_per_pixel>=3) ? ch : in.channel;
+			if(in.bit_depth==16) {
+				rs_stream_put_row_u16(&c->stream[ch], y, (const unsigned short*)row,
+					in.samples_per_pixel, offset, cc_table);
+			}
+			else {
+				rs_stream_put_row_u8(&c->stream[ch], y, (const unsigned char*)row,
+					in.samples_per_pixel, offset, cc_table);
 			}
 		}
-
+		timing_add(c,STAGE_EXTRACT,t0,(double)in.width);
 	}
-	return 1;
-}
 
-static void decide_scale_factor(struct context *c, struct infile_info *inf, int src_width)
-{
-	// Start with the default scale factor:
-	c->scale_factor = ((double)c->w) / src_width;
-	c->natural_scale_factor = c->scale_factor;
-
-	if(inf->scale_factor_req_set) {
-		// scale factor overridden by user
-		c->scale_factor = inf->scale_factor_req;
-	}
+	retval=1;
+	goto done;
 
-	if(inf->scale_fudge_factor_req_set) {
-		// adjust the scale factor as requested
-		c->scale_factor *= inf->scale_fudge_factor_req;
+readerr:
+	printmsg(c, "* Error: Failed to decode %s: %s\n",fn,in.errmsg);
+done:
+	if(!retval && c->stream_valid) {
+		free_streams(c);
 	}
+	rsin_close(&in);
+	free(row);
+	free(cc_table);
+	return retval;
 }
 
-static int run_dotimg_1file(struct context *c, struct infile_info *inf)
+// Makes the simulated image for 'inf', and converts it to c->stream the same
+// way decode_image() would.
+static int simulate_image(struct context *c, struct infile_info *inf, int pattern)
 {
+	int y;
+	int ch;
+	int src_w, src_h;
+	int w, h; // Size of the simulated image, as if it were a file
+	unsigned char *buf = NULL;
+	double cc_table[256];
+	double t0;
 	int retval=0;
-	int i;
-
-	printmsg(c, " Reading %s\n",inf->fn);
 
-	if(!open_file_for_reading(c,inf->fn)) goto done;
+	t0 = timer_now();
+	rs_pattern_size(pattern,&src_w,&src_h);
+	w = c->rotated ? src_h : inf->sim_width;
+	h = c->rotated ? inf->sim_width : src_h;
 
-	c->w = rs_gdImageSX(c,c->im_in);
-	c->h = rs_gdImageSY(c,c->im_in);
-	if(c->h != DOTIMG_SRC_HEIGHT) {
-		printmsg(c, "* Error: Image is wrong height (is %d, should be %d)\n",c->h,DOTIMG_SRC_HEIGHT);
-		goto done;
-	}
-	if(c->w<50) {
-		printmsg(c, "* Error: Image is wrong width (is %d, must be at least 50)\n",c->w);
+	buf = malloc((size_t)w*h);
+	if(!buf ||
+		!rs_simulate(pattern,c->rotated,&inf->sim_filter,inf->sim_srgb,inf->sim_width,buf))
+	{
+		printmsg(c, "* Error: Out of memory\n");
 		goto done;
 	}
 
-	decide_scale_factor(c,inf,DOTIMG_SRC_WIDTH);
+	if(inf->sim_outfn) {
+		if(!write_gray_image(c,buf,w,h,inf->sim_outfn)) goto done;
+		printmsg(c, " Wrote %s\n",inf->sim_outfn);
+	}
 
-	gr_draw_graph_name(c,inf,1);
+	if(!init_streams(c, inf, pattern, w, h)) goto done;
+	c->stream_step = 1.0;
 
-	for(i=0;i<DOTIMG_NUMSTRIPS;i++) {
-		if(!plot_strip(c,inf,i)) goto done;
+	rs_make_cc_table(inf->color_correction_method, inf->gamma, cc_table);
+	for(y=0;y<h;y++) {
+		if(!rs_stream_row_needed(&c->stream[CHANNEL_G],y)) continue;
+		for(ch=0;ch<NUM_CHANNELS;ch++) {
+			if(!channel_used(c,ch)) continue;
+			rs_stream_put_row_u8(&c->stream[ch], y, &buf[(size_t)y*w], 1, 0, cc_table);
+		}
 	}
 
+	timing_add(c,STAGE_SIMULATE,t0,(double)w*(double)h);
 	retval=1;
 done:
-	close_file_for_reading(c);
-	c->graph_count++;
+	free(buf);
 	return retval;
 }
 
-static int run_ds(struct context *c)
+static void close_file_for_reading(struct context *c)
 {
-	int ret;
-
-	printmsg(c, "Writing %s [dot pattern]\n",c->outfn);
-
-	gr_init(c);
-	c->border_color = gdImageColorResolve(c->im_out,144,192,144);
-	gr_draw_grid(c);
-	gr_draw_logo(c);
-
-	if(c->inf[1].fn) {
-		c->curr_color = gdImageColorResolve(c->im_out,
-		  c->inf[1].color_r,c->inf[1].color_g,c->inf[1].color_b);
-		ret = run_dotimg_1file(c,&c->inf[1]);
-		c->lastpos_set = 0;
+	if(c->stream_valid) {
+		free_streams(c);
 	}
-
-	c->curr_color = gdImageColorResolve(c->im_out,
-	  c->inf[0].color_r,c->inf[0].color_g,c->inf[0].color_b);
-	ret = run_dotimg_1file(c,&c->inf[0]);
-
-	gr_done(c);
-	return ret;
+	if(c->im_in_fp) { fclose(c->im_in_fp); c->im_in_fp = NULL; }
+	free(c->im_in_data);
+	c->im_in_data = NULL;
 }
 
-////////////////////////////////////////////////
-
+//////////////////// THREADS ///////////////////
 
-//////////////////// LINEIMG ///////////////////
+// A minimal portable wrapper for the threading features that batch mode and
+// the -ff auto search need: a lock, and a way to wait for other threads to
+// make progress.
 
-static void gr_lineimg_graph_main(struct context *c, struct infile_info *inf)
+struct rs_sync {
+#ifdef RS_WINDOWS
+	CRITICAL_SECTION lock;
+	HANDLE event;
+#else
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+#endif
+};
+
+#ifdef RS_WINDOWS
+
+typedef HANDLE rs_thread;
+
+static void rs_sync_init(struct rs_sync *sy)
+{
+	InitializeCriticalSection(&sy->lock);
+	sy->event = CreateEvent(NULL, FALSE, FALSE, NULL);
+}
+
+static void rs_sync_destroy(struct rs_sync *sy)
+{
+	CloseHandle(sy->event);
+	DeleteCriticalSection(&sy->lock);
+}
+
+static void rs_sync_lock(struct rs_sync *sy)   { EnterCriticalSection(&sy->lock); }
+static void rs_sync_unlock(struct rs_sync *sy) { LeaveCriticalSection(&sy->lock); }
+static void rs_sync_notify(struct rs_sync *sy) { SetEvent(sy->event); }
+
+// Must be called with the lock held. Waits for rs_sync_notify() to be called.
+static void rs_sync_wait(struct rs_sync *sy)
+{
+	LeaveCriticalSection(&sy->lock);
+	WaitForSingleObject(sy->event, INFINITE);
+	EnterCriticalSection(&sy->lock);
+}
+
+struct rs_thread_start_info {
+	void (*fn)(void*);
+	void *arg;
+};
+
+static DWORD WINAPI rs_thread_main(LPVOID param)
+{
+	struct rs_thread_start_info si;
+	si = *(struct rs_thread_start_info*)param;
+	free(param);
+	si.fn(si.arg);
+	return 0;
+}
+
+static int rs_thread_create(rs_thread *t, void (*fn)(void*), void *arg)
+{
+	struct rs_thread_start_info *si;
+
+	si = malloc(sizeof(struct rs_thread_start_info));
+	if(!si) return 0;
+	si->fn = fn;
+	si->arg = arg;
+	*t = CreateThread(NULL, 0, rs_thread_main, si, 0, NULL);
+	if(!*t) {
+		free(si);
+		return 0;
+	}
+	return 1;
+}
+
+static void rs_thread_join(rs_thread t)
+{
+	WaitForSingleObject(t, INFINITE);
+	CloseHandle(t);
+}
+
+static int rs_num_processors(void)
+{
+	SYSTEM_INFO si;
+	GetSystemInfo(&si);
+	return (int)si.dwNumberOfProcessors;
+}
+
+#else
+
+typedef pthread_t rs_thread;
+
+static void rs_sync_init(struct rs_sync *sy)
+{
+	pthread_mutex_init(&sy->lock, NULL);
+	pthread_cond_init(&sy->cond, NULL);
+}
+
+static void rs_sync_destroy(struct rs_sync *sy)
 {
+	pthread_cond_destroy(&sy->cond);
+	pthread_mutex_destroy(&sy->lock);
+}
+
+static void rs_sync_lock(struct rs_sync *sy)   { pthread_mutex_lock(&sy->lock); }
+static void rs_sync_unlock(struct rs_sync *sy) { pthread_mutex_unlock(&sy->lock); }
+static void rs_sync_notify(struct rs_sync *sy) { pthread_cond_broadcast(&sy->cond); }
+
+// Must be called with the lock held. Waits for rs_sync_notify() to be called.
+static void rs_sync_wait(struct rs_sync *sy)
+{
+	pthread_cond_wait(&sy->cond, &sy->lock);
+}
+
+struct rs_thread_start_info {
+	void (*fn)(void*);
+	void *arg;
+};
+
+static void *rs_thread_main(void *param)
+{
+	struct rs_thread_start_info si;
+	si = *(struct rs_thread_start_info*)param;
+	free(param);
+	si.fn(si.arg);
+	return NULL;
+}
+
+static int rs_thread_create(rs_thread *t, void (*fn)(void*), void *arg)
+{
+	struct rs_thread_start_info *si;
+
+	si = malloc(sizeof(struct rs_thread_start_info));
+	if(!si) return 0;
+	si->fn = fn;
+	si->arg = arg;
+	if(pthread_create(t, NULL, rs_thread_main, si)!=0) {
+		free(si);
+		return 0;
+	}
+	return 1;
+}
+
+static void rs_thread_join(rs_thread t)
+{
+	pthread_join(t, NULL);
+}
+
+static int rs_num_processors(void)
+{
+	long n;
+	n = sysconf(_SC_NPROCESSORS_ONLN);
+	return (n>0) ? (int)n : 1;
+}
+
+#endif
+
+// State for cli_parallel_for().
+struct pfor_state {
+	int n;
+	int next; // The next index to be processed
+	void (*fn)(void *arg, int i);
+	void *arg;
+	struct rs_sync sync;
+};
+
+static void pfor_worker(void *arg)
+{
+	struct pfor_state *ps = (struct pfor_state*)arg;
 	int i;
-	double v;
-	int clr;
-	double xp, yp;
-	double tot = 0.0;
-	double area;
 
-	clr = c->curr_color;
+	while(1) {
+		rs_sync_lock(&ps->sync);
+		i = ps->next++;
+		rs_sync_unlock(&ps->sync);
+		if(i>=ps->n) break;
+		ps->fn(ps->arg,i);
+	}
+}
 
-	if(inf->thicklines)
-		gdImageSetThickness(c->im_out,3);
+// An rs_parallel_for_fn, for the analysis library. 'userdata' is the context.
+// The calling thread does some of the work, so this works even if no threads
+// can be created.
+static void cli_parallel_for(void *userdata, int n,
+	void (*fn)(void *arg, int i), void *arg)
+{
+	struct context *c = (struct context*)userdata;
+	struct pfor_state ps;
+	rs_thread *threads = NULL;
+	int nthreads;
+	int num_started = 0;
+	int i;
+
+	nthreads = c->search_nthreads;
+	if(nthreads<1) nthreads = rs_num_processors();
+	if(nthreads>n) nthreads = n;
 
-	for(i=0;i<c->w;i++) {
-		v = c->samples[i];
-		yp = (v-50.0)/200.0;
-		tot += yp;
-		xp = 0.5+(double)i-(((double)c->w)/2.0);
+	ps.n = n;
+	ps.next = 0;
+	ps.fn = fn;
+	ps.arg = arg;
+	rs_sync_init(&ps.sync);
 
-		if(c->scale_factor < 1.0) {
-			yp /= c->scale_factor;
+	if(nthreads>1) {
+		threads = malloc((nthreads-1)*sizeof(rs_thread));
+	}
+	if(threads) {
+		for(i=0;i<nthreads-1;i++) {
+			if(!rs_thread_create(&threads[num_started],pfor_worker,&ps)) break;
+			num_started++;
 		}
-		else {
-			xp /= c->scale_factor;
+	}
+
+	pfor_worker(&ps);
+
+	for(i=0;i<num_started;i++) {
+		rs_thread_join(threads[i]);
+	}
+	free(threads);
+	rs_sync_destroy(&ps.sync);
+}
+
+///////////////////////////////////////////////
+
+// Analyzes one channel (CHANNEL_*) of the image in c->stream.
+// On success, the result must eventually be freed with rs_result_free().
+static int analyze_channel(struct context *c, struct infile_info *inf, int pattern,
+	int ch, struct rs_result *r)
+{
+	int search_ok=0;
+	double ff, scatter;
+	double t0;
+	struct rs_params params;
+	char label[10];
+
+	// With -channels rgb, label the messages with the channel.
+	if(c->channels_rgb)
+		my_snprintf(label, sizeof(label), " (%s)", channel_name(ch));
+	else
+		label[0] = '\0';
+
+	t0 = timer_now();
+	params = inf->params;
+	if(inf->auto_ff) {
+		if(pattern==PATTERN_DOTIMG) {
+			params.scale_fudge_factor_req_set = 0;
+			search_ok = rs_stream_find_ff(&c->stream[ch],&params,0.02,cli_parallel_for,(void*)c,
+				&ff,&scatter);
+			if(search_ok) {
+				params.scale_fudge_factor_req = ff;
+				params.scale_fudge_factor_req_set = 1;
+			}
 		}
+		else if(ch==CHANNEL_G) {
+			printmsg(c, "* Warning: -ff auto only works with the dot pattern\n");
+		}
+	}
 
-		gr_lineto(c,xp,yp,clr);
+	if(!rs_stream_analyze(&c->stream[ch],pattern,&params,r)) {
+		print_analysis_error(c,r->errcode,r->w,r->h);
+		return 0;
 	}
+	timing_add(c,STAGE_ANALYZE,t0,(double)c->stream[ch].w*(double)c->stream[ch].h);
 
-	gdImageSetThickness(c->im_out,1);
+	if(inf->auto_ff && pattern==PATTERN_DOTIMG) {
+		if(!search_ok) {
+			printmsg(c, "* Error: Scale factor search failed\n");
+			rs_result_free(r);
+			return 0;
+		}
+		printmsg(c, "  Fudge factor%s: %.8f (scatter=%.6f)\n",label,ff,scatter);
+	}
 
-	area = tot/c->scale_factor;
-	printmsg(c, "  Area = %.6f",area);
-	printmsg(c, "\n");
+	if(r->has_area) {
+		printmsg(c, "  Area%s = %.6f\n",label,r->area);
+	}
+
+	if(r->has_support) {
+		printmsg(c, "  Support%s = %.3f (%.3f source pixels), taps per output pixel = %d\n",
+			label,r->support,r->support_src,r->taps);
+	}
+
+	return 1;
 }
 
-static int run_lineimg_1file(struct context *c, struct infile_info *inf)
+// Reads and analyzes the file for 'inf'. The results for each channel
+// (CHANNEL_*) are written to r[], and r_valid[] is set for each one.
+// On success, the results must eventually be freed with rs_result_free().
+static int analyze_file(struct context *c, struct infile_info *inf, int pattern,
+	struct rs_result *r, int *r_valid)
 {
+	int ch;
 	int retval=0;
+
+	if(inf->simulate) {
+		printmsg(c, " Simulating %s\n",inf->sim_desc);
+		if(!simulate_image(c,inf,pattern)) goto done;
+	}
+	else {
+		printmsg(c, " Reading %s\n",inf->fn);
+		if(!open_file_for_reading(c,inf->fn)) goto done;
+		if(!decode_image(c,inf->fn,inf,pattern)) goto done;
+	}
+
+	for(ch=0;ch<NUM_CHANNELS;ch++) {
+		if(!channel_used(c,ch)) continue;
+		if(!analyze_channel(c,inf,pattern,ch,&r[ch])) goto done;
+		r_valid[ch] = 1;
+	}
+
+	retval=1;
+done:
+	if(!retval) {
+		for(ch=0;ch<NUM_CHANNELS;ch++) {
+			if(r_valid[ch]) {
+				rs_result_free(&r[ch]);
+				r_valid[ch] = 0;
+			}
+		}
+	}
+	close_file_for_reading(c);
+	return retval;
+}
+
+//////////////////// DATA EXPORT ////////////////////
+
+static int data_format_from_fn(const char *fn)
+{
+	const char *ext;
+
+	ext = strrchr(fn,'.');
+	if(ext) {
+		if(!strcmp(ext,".json")) return OUTFMT_JSON;
+		if(!strcmp(ext,".bin")) return OUTFMT_BIN;
+	}
+	return OUTFMT_CSV;
+}
+
+static const char *pattern_name(int pattern)
+{
+	return (pattern==PATTERN_DOTIMG) ? "dot" : "line";
+}
+
+static void write_json_string(FILE *w, const char *s)
+{
+	const unsigned char *p;
+
+	fputc('"',w);
+	for(p=(const unsigned char*)s; *p; p++) {
+		if(*p=='"' || *p=='\\') {
+			fputc('\\',w);
+			fputc(*p,w);
+		}
+		else if(*p<32) {
+			fprintf(w,"\\u%04x",(unsigned int)*p);
+		}
+		else {
+			fputc(*p,w);
+		}
+	}
+	fputc('"',w);
+}
+
+// Returns the friendly name of input file 'inf' (in buf).
+static const char *get_inf_name(struct infile_info *inf, char *buf, size_t buflen)
+{
+	if(inf->name) return inf->name;
+	gr_get_name_from_fn(inf->fn,buf,buflen);
+	return buf;
+}
+
+static void write_timing_csv(struct context *c, FILE *w)
+{
 	int i;
-	int scanline; // The (middle) scanline we'll analyze
+	double kb;
 
-	printmsg(c, " Reading %s\n",inf->fn);
+	hwc_read(&c->hwc);
+	for(i=0;i<NUM_STAGES;i++) {
+		if(c->stage_time[i]==0.0) continue;
+		fprintf(w,"# timing stage=%s seconds=%.9f pixels=%.0f\n",stage_name(i),
+			c->stage_time[i],c->stage_pixels[i]);
+	}
+	fprintf(w,"# timing elapsed=%.9f\n",timer_now()-c->timing_start);
+	kb = peak_memory_kb();
+	if(kb>=0.0) {
+		fprintf(w,"# timing peak_memory_kb=%.0f\n",kb);
+	}
+	if(c->hwc.ok) {
+		fprintf(w,"# timing cycles=%.0f instructions=%.0f\n",
+			c->hwc.cycles,c->hwc.instructions);
+	}
+}
 
-	if(!open_file_for_reading(c,inf->fn)) {
-		goto done;
+static void write_timing_json(struct context *c, FILE *w)
+{
+	int i;
+	double kb;
+
+	hwc_read(&c->hwc);
+	fprintf(w,"\"timing\": {\n\"stages\": {");
+	for(i=0;i<NUM_STAGES;i++) {
+		fprintf(w,"%s\n\"%s\": {\"seconds\": %.9f, \"pixels\": %.0f}",(i>0)?",":"",
+			stage_name(i),c->stage_time[i],c->stage_pixels[i]);
+	}
+	fprintf(w,"\n},\n\"elapsed\": %.9f",timer_now()-c->timing_start);
+	kb = peak_memory_kb();
+	if(kb>=0.0) {
+		fprintf(w,",\n\"peak_memory_kb\": %.0f",kb);
 	}
+	if(c->hwc.ok) {
+		fprintf(w,",\n\"cycles\": %.0f,\n\"instructions\": %.0f",
+			c->hwc.cycles,c->hwc.instructions);
+	}
+	fprintf(w,"\n},\n");
+}
+
+// CSV format: For each input file, some "#" comment lines with the
+// information about the file, followed by one line per sample.
+// With -channels rgb, each channel of each file is listed separately, and
+// there is an extra "channel" column.
+static void write_data_csv(struct context *c, FILE *w)
+{
+	int k, ch, i;
+	struct rs_result *r;
+	struct rs_match *m;
+	char namebuf[100];
+	char fname[RS_FILTER_NAME_LEN];
+
+	fprintf(w,"# ResampleScope %s\n",RS_VERSION);
+	if(c->timing) write_timing_csv(c,w);
+	for(k=0;k<2;k++) {
+		for(ch=0;ch<NUM_CHANNELS;ch++) {
+			if(!c->res_valid[k][ch]) continue;
+			r = &c->res[k][ch];
+			if(c->channels_rgb)
+				fprintf(w,"# index=%d channel=%s file=%s\n",k,channel_name(ch),c->inf[k].fn);
+			else
+				fprintf(w,"# index=%d file=%s\n",k,c->inf[k].fn);
+			fprintf(w,"# name=%s\n",get_inf_name(&c->inf[k],namebuf,sizeof(namebuf)));
+			fprintf(w,"# pattern=%s width=%d height=%d\n",pattern_name(r->pattern),r->w,r->h);
+			fprintf(w,"# natural_scale_factor=%.17g scale_factor=%.17g\n",
+				r->natural_scale_factor,r->scale_factor);
+			if(r->has_area) {
+				fprintf(w,"# area=%.17g\n",r->area);
+			}
+			if(r->has_scatter) {
+				fprintf(w,"# scatter=%.17g\n",r->scatter);
+			}
+			if(r->has_support) {
+				fprintf(w,"# support=%.17g support_src=%.17g taps=%d\n",
+					r->support,r->support_src,r->taps);
+			}
+			if(c->quant_valid[k][ch]) {
+				fprintf(w,"# quant_bits=%d quant_confidence=%.17g quant_max_bits=%d\n",
+					c->quant[k][ch].bits,c->quant[k][ch].confidence,c->quant[k][ch].max_bits);
+			}
+			if(c->phases_valid[k][ch]) {
+				fprintf(w,"# phases=%d phases_confidence=%.17g snap_error=%.17g max_phases=%d\n",
+					c->phases[k][ch].phases,c->phases[k][ch].confidence,
+					c->phases[k][ch].snap_error,c->phases[k][ch].max_phases);
+			}
+			for(i=0;i<c->num_matches[k][ch];i++) {
+				m = &c->matches[k][ch][i];
+				rs_filter_name(&m->filter,fname);
+				fprintf(w,"# match rank=%d filter=%s residual=%.17g amplitude=%.17g\n",
+					i+1,fname,m->residual,m->amplitude);
+			}
+		}
+	}
+
+	fprintf(w,c->channels_rgb ? "file,channel,strip,x,y\n" : "file,strip,x,y\n");
+	for(k=0;k<2;k++) {
+		for(ch=0;ch<NUM_CHANNELS;ch++) {
+			if(!c->res_valid[k][ch]) continue;
+			r = &c->res[k][ch];
+			for(i=0;i<r->num_samples;i++) {
+				if(c->channels_rgb)
+					fprintf(w,"%d,%s,",k,channel_name(ch));
+				else
+					fprintf(w,"%d,",k);
+				fprintf(w,"%d,%.17g,%.17g\n",r->samples[i].strip,
+					r->samples[i].x,r->samples[i].y);
+			}
+		}
+	}
+}
+
+static void write_data_json(struct context *c, FILE *w)
+{
+	int k, ch, i;
+	int count = 0;
+	struct rs_result *r;
+	struct rs_match *m;
+	char namebuf[100];
+	char fname[RS_FILTER_NAME_LEN];
+
+	fprintf(w,"{\n\"version\": \"%s\",\n",RS_VERSION);
+	if(c->timing) write_timing_json(c,w);
+	fprintf(w,"\"files\": [");
+	for(k=0;k<2;k++) {
+		for(ch=0;ch<NUM_CHANNELS;ch++) {
+			if(!c->res_valid[k][ch]) continue;
+			r = &c->res[k][ch];
+			fprintf(w,"%s\n{\n\"index\": %d,\n",(count>0)?",":"",k);
+			if(c->channels_rgb) {
+				fprintf(w,"\"channel\": \"%s\",\n",channel_name(ch));
+			}
+			fprintf(w,"\"file\": ");
+			write_json_string(w,c->inf[k].fn);
+			fprintf(w,",\n\"name\": ");
+			write_json_string(w,get_inf_name(&c->inf[k],namebuf,sizeof(namebuf)));
+			fprintf(w,",\n\"pattern\": \"%s\",\n",pattern_name(r->pattern));
+			fprintf(w,"\"width\": %d,\n\"height\": %d,\n",r->w,r->h);
+			fprintf(w,"\"natural_scale_factor\": %.17g,\n",r->natural_scale_factor);
+			fprintf(w,"\"scale_factor\": %.17g,\n",r->scale_factor);
+			if(r->has_area) {
+				fprintf(w,"\"area\": %.17g,\n",r->area);
+			}
+			if(r->has_scatter) {
+				fprintf(w,"\"scatter\": %.17g,\n",r->scatter);
+			}
+			if(r->has_support) {
+				fprintf(w,"\"support\": %.17g,\n\"support_src\": %.17g,\n\"taps\": %d,\n",
+					r->support,r->support_src,r->taps);
+			}
+			if(c->quant_valid[k][ch]) {
+				fprintf(w,"\"quant_bits\": %d,\n\"quant_confidence\": %.17g,\n\"quant_max_bits\": %d,\n",
+					c->quant[k][ch].bits,c->quant[k][ch].confidence,c->quant[k][ch].max_bits);
+			}
+			if(c->phases_valid[k][ch]) {
+				fprintf(w,"\"phases\": %d,\n\"phases_confidence\": %.17g,\n\"snap_error\": %.17g,\n\"max_phases\": %d,\n",
+					c->phases[k][ch].phases,c->phases[k][ch].confidence,
+					c->phases[k][ch].snap_error,c->phases[k][ch].max_phases);
+			}
+			if(c->num_matches[k][ch]>0) {
+				fprintf(w,"\"matches\": [");
+				for(i=0;i<c->num_matches[k][ch];i++) {
+					m = &c->matches[k][ch][i];
+					rs_filter_name(&m->filter,fname);
+					fprintf(w,"%s\n{\"filter\": \"%s\", \"residual\": %.17g, \"amplitude\": %.17g}",
+						(i>0)?",":"",fname,m->residual,m->amplitude);
+				}
+				fprintf(w,"\n],\n");
+			}
+			fprintf(w,"\"samples\": [");
+			for(i=0;i<r->num_samples;i++) {
+				fprintf(w,"%s\n[%.17g,%.17g,%d]",(i>0)?",":"",
+					r->samples[i].x,r->samples[i].y,r->samples[i].strip);
+			}
+			fprintf(w,"\n]\n}");
+			count++;
+		}
+	}
+	fprintf(w,"\n]\n}\n");
+}
+
+static void write_u32le(FILE *w, unsigned int n)
+{
+	unsigned char buf[4];
+	buf[0] = (unsigned char)(n&0xff);
+	buf[1] = (unsigned char)((n>>8)&0xff);
+	buf[2] = (unsigned char)((n>>16)&0xff);
+	buf[3] = (unsigned char)((n>>24)&0xff);
+	fwrite(buf,1,4,w);
+}
+
+// Assumes that doubles are in IEEE 754 format.
+static void write_f64le(FILE *w, double d)
+{
+	unsigned char b[8];
+	unsigned char buf[8];
+	int i;
+	unsigned int one = 1;
 
-	c->w = rs_gdImageSX(c,c->im_in);
-	c->h = rs_gdImageSY(c,c->im_in);
+	memcpy(b,&d,8);
+	for(i=0;i<8;i++) {
+		// Convert to little-endian, if necessary.
+		buf[i] = (*(unsigned char*)&one) ? b[i] : b[7-i];
+	}
+	fwrite(buf,1,8,w);
+}
 
-	if(c->h < 3) {
-		printmsg(c, "Image height (%d) too small\n",c->h);
+// Binary format (all integers and floating point numbers are little-endian):
+//   8 bytes: "RSCOPE\0\1" (signature and format version), or "RSCOPE\0\2"
+//            with -channels rgb
+//   uint32:  number of files (with version 2, the number of file channels)
+// For each file:
+//   uint32:  file index (0 = primary, 1 = secondary)
+//   uint32:  (version 2 only) channel (0 = red, 1 = green, 2 = blue)
+//   uint32:  pattern (1 = line, 2 = dot)
+//   uint32:  width
+//   uint32:  height
+//   uint32:  1 if there is an area, else 0
+//   float64: natural scale factor
+//   float64: scale factor
+//   float64: area
+//   uint32:  length of the filename, followed by the filename (UTF-8)
+//   uint32:  number of samples
+//   For each sample: float64 x, float64 y, uint32 strip
+static void write_data_bin(struct context *c, FILE *w)
+{
+	int k, ch, i;
+	unsigned int n = 0;
+	struct rs_result *r;
+
+	if(c->channels_rgb)
+		fwrite("RSCOPE\0\2",1,8,w);
+	else
+		fwrite("RSCOPE\0\1",1,8,w);
+	for(k=0;k<2;k++) {
+		for(ch=0;ch<NUM_CHANNELS;ch++) {
+			if(c->res_valid[k][ch]) n++;
+		}
+	}
+	write_u32le(w,n);
+
+	for(k=0;k<2;k++) {
+		for(ch=0;ch<NUM_CHANNELS;ch++) {
+			if(!c->res_valid[k][ch]) continue;
+			r = &c->res[k][ch];
+			write_u32le(w,(unsigned int)k);
+			if(c->channels_rgb) {
+				write_u32le(w,(unsigned int)ch);
+			}
+			write_u32le(w,(unsigned int)r->pattern);
+			write_u32le(w,(unsigned int)r->w);
+			write_u32le(w,(unsigned int)r->h);
+			write_u32le(w,(unsigned int)r->has_area);
+			write_f64le(w,r->natural_scale_factor);
+			write_f64le(w,r->scale_factor);
+			write_f64le(w,r->area);
+			write_u32le(w,(unsigned int)strlen(c->inf[k].fn));
+			fwrite(c->inf[k].fn,1,strlen(c->inf[k].fn),w);
+			write_u32le(w,(unsigned int)r->num_samples);
+			for(i=0;i<r->num_samples;i++) {
+				write_f64le(w,r->samples[i].x);
+				write_f64le(w,r->samples[i].y);
+				write_u32le(w,(unsigned int)r->samples[i].strip);
+			}
+		}
+	}
+}
+
+// Write the analysis results in c->res to a file.
+static int write_data_file(struct context *c, const char *fn, int fmt)
+{
+	FILE *w;
+
+	w = open_output(fn);
+	if(!w) {
+		printmsg(c, "* Error: Failed to write %s\n",fn);
+		return 0;
+	}
+
+	if(fmt==OUTFMT_JSON)
+		write_data_json(c,w);
+	else if(fmt==OUTFMT_BIN)
+		write_data_bin(c,w);
+	else
+		write_data_csv(c,w);
+
+	if(close_output(w)) {
+		printmsg(c, "* Error: Failed to write %s\n",fn);
+		return 0;
+	}
+	return 1;
+}
+
+// The spacing of the kernel table written by write_kernel_file().
+#define KERNEL_STEP (1.0/64.0)
+
+static void write_float_table(FILE *w, const double *v, int n, const char *indent)
+{
+	int i;
+
+	for(i=0;i<n;i++) {
+		if(i%8==0) fputs(indent,w);
+		fprintf(w,"%s%.8ff,",(i%8==0)?"":" ",v[i]);
+		if(i%8==7 || i==n-1) fputc('\n',w);
+	}
+}
+
+// Writes the filter from the primary file to a C header file: a table of the
+// filter itself, and polyphase tables of weights for resizing with it.
+// The header uses C89 comments, since it may be used anywhere.
+static int write_kernel_file(struct context *c, const char *fn)
+{
+	struct rs_result *r = &c->res[0][CHANNEL_G];
+	struct rs_kernel k;
+	struct rs_polyphase pp;
+	double scale;
+	FILE *w = NULL;
+	int p, t;
+	int retval = 0;
+	char namebuf[100];
+
+	memset(&k,0,sizeof(struct rs_kernel));
+	memset(&pp,0,sizeof(struct rs_polyphase));
+
+	if(!c->res_valid[0][CHANNEL_G]) goto done;
+	scale = (c->kernel_scale>0.0) ? c->kernel_scale : r->scale_factor;
+	if(!rs_kernel_from_result(r,KERNEL_STEP,&k) ||
+		!rs_kernel_polyphase(&k,scale,c->kernel_phases,c->kernel_bits,&pp))
+	{
+		printmsg(c, "* Error: Failed to make the kernel tables\n");
 		goto done;
 	}
 
-	decide_scale_factor(c,inf,LINEIMG_SRC_WIDTH);
+	w = open_output(fn);
+	if(!w) {
+		printmsg(c, "* Error: Failed to write %s\n",fn);
+		goto done;
+	}
 
-	gr_draw_graph_name(c,inf,1);
+	fprintf(w,"/* Resampling filter recovered by ResampleScope %s\n",RS_VERSION);
+	fprintf(w," * From: %s (%s), %s pattern, scale factor %.6f\n",c->inf[0].fn,
+		get_inf_name(&c->inf[0],namebuf,sizeof(namebuf)),pattern_name(r->pattern),
+		r->scale_factor);
+	fprintf(w," *\n"
+		" * rscope_kernel[i] is the value of the filter at distance\n"
+		" * i*RSCOPE_KERNEL_STEP from its center, at its natural size (as graphed).\n"
+		" * It has an area of 1, and is 0 beyond RSCOPE_KERNEL_RADIUS.\n"
+		" *\n"
+		" * The polyphase tables are for resizing by RSCOPE_KERNEL_SCALE target\n"
+		" * pixels per source pixel. For target pixel x, let\n"
+		" * c = (x+0.5)/RSCOPE_KERNEL_SCALE - 0.5, i = floor(c), and\n"
+		" * p = floor((c-i)*RSCOPE_KERNEL_PHASES + 0.5). If p == RSCOPE_KERNEL_PHASES,\n"
+		" * add 1 to i and set p to 0. Then tap t of phase p applies to source\n"
+		" * pixel i + RSCOPE_KERNEL_FIRST_TAP + t.\n"
+		" */\n\n");
+
+	fprintf(w,"#ifndef RSCOPE_KERNEL_H\n#define RSCOPE_KERNEL_H\n\n");
+	fprintf(w,"#define RSCOPE_KERNEL_RADIUS    %.8f\n",k.radius);
+	fprintf(w,"#define RSCOPE_KERNEL_STEP      %.8f\n",k.step);
+	fprintf(w,"#define RSCOPE_KERNEL_SIZE      %d\n",k.n);
+	fprintf(w,"#define RSCOPE_KERNEL_SCALE     %.17g\n",scale);
+	fprintf(w,"#define RSCOPE_KERNEL_PHASES    %d\n",pp.phases);
+	fprintf(w,"#define RSCOPE_KERNEL_TAPS      %d\n",pp.taps);
+	fprintf(w,"#define RSCOPE_KERNEL_FIRST_TAP (%d)\n",pp.first_tap);
+	if(pp.q) {
+		fprintf(w,"#define RSCOPE_KERNEL_FRAC_BITS %d\n",pp.frac_bits);
+	}
 
-	scanline = c->h / 2;
+	fprintf(w,"\nstatic const float rscope_kernel[RSCOPE_KERNEL_SIZE] = {\n");
+	write_float_table(w,k.v,k.n,"\t");
+	fprintf(w,"};\n");
 
-	// Copy the samples we're analyzing
-	c->samples = malloc(sizeof(double)*c->w);
-	for(i=0;i<c->w;i++) {
-		// Read from three different scanlines, to give us a chance of
-		// detecting weird issues where the scanlines aren't identical.
-		c->samples[i] = rs_gdImageGetPixel(c, inf, c->im_in,
-			i, scanline+(i%3)-1);
+	fprintf(w,"\n/* The weights of each phase add up to 1. */\n");
+	fprintf(w,"static const float rscope_kernel_weights[RSCOPE_KERNEL_PHASES][RSCOPE_KERNEL_TAPS] = {\n");
+	for(p=0;p<pp.phases;p++) {
+		fprintf(w,"\t{ /* phase %d */\n",p);
+		write_float_table(w,&pp.w[(size_t)p*pp.taps],pp.taps,"\t\t");
+		fprintf(w,"\t},\n");
+	}
+	fprintf(w,"};\n");
+
+	if(pp.q) {
+		fprintf(w,"\n/* The weights of each phase add up to exactly 1<<RSCOPE_KERNEL_FRAC_BITS. */\n");
+		fprintf(w,"static const %s rscope_kernel_weights_fixed[RSCOPE_KERNEL_PHASES][RSCOPE_KERNEL_TAPS] = {\n",
+			(pp.frac_bits<=14)?"short":"int");
+		for(p=0;p<pp.phases;p++) {
+			fprintf(w,"\t{");
+			for(t=0;t<pp.taps;t++) {
+				fprintf(w,"%s%d",(t>0)?", ":" ",pp.q[(size_t)p*pp.taps+t]);
+			}
+			fprintf(w," }, /* phase %d */\n",p);
+		}
+		fprintf(w,"};\n");
 	}
 
-	gr_lineimg_graph_main(c,inf);
-	retval=1;
+	fprintf(w,"\n#endif /* RSCOPE_KERNEL_H */\n");
+	if(close_output(w)) {
+		printmsg(c, "* Error: Failed to write %s\n",fn);
+		goto done;
+	}
+	retval = 1;
 done:
-	close_file_for_reading(c);
-	if(c->samples) { free(c->samples); c->samples=NULL; }
-	c->graph_count++;
+	rs_kernel_free(&k);
+	rs_polyphase_free(&pp);
 	return retval;
 }
 
-static int run_us(struct context *c)
-{
-	int ret = 0;
+///////////////////////////////////////////////
+
+// Finds the known filters that best match c->res[idx][ch], and prints them.
+static void identify_result(struct context *c, int idx, int ch)
+{
+	double t0;
+	int i, n;
+	struct rs_match *m;
+	char fname[RS_FILTER_NAME_LEN];
+
+	t0 = timer_now();
+	n = rs_identify(&c->res[idx][ch],cli_parallel_for,(void*)c,
+		c->matches[idx][ch],IDENTIFY_NUM_MATCHES);
+	c->num_matches[idx][ch] = n;
+	timing_add(c,STAGE_ANALYZE,t0,0.0);
+	if(n<1) {
+		printmsg(c, "* Warning: Failed to identify the filter\n");
+		return;
+	}
+
+	if(c->channels_rgb)
+		printmsg(c, "  Best matching filters (%s):\n",channel_name(ch));
+	else
+		printmsg(c, "  Best matching filters:\n");
+	for(i=0;i<n;i++) {
+		m = &c->matches[idx][ch][i];
+		rs_filter_name(&m->filter,fname);
+		printmsg(c, "    %-20s residual=%.6f amplitude=%.4f\n",fname,m->residual,m->amplitude);
+	}
+}
+
+// Estimates the precision of the filter weights for c->res[idx][ch], and
+// prints it.
+static void quant_result(struct context *c, int idx, int ch, struct infile_info *inf)
+{
+	struct rs_quant *q = &c->quant[idx][ch];
+	char label[10];
+
+	if(c->res[idx][ch].pattern!=PATTERN_LINEIMG) {
+		if(ch==CHANNEL_G) {
+			printmsg(c, "* Warning: -quant only works with the line pattern\n");
+		}
+		return;
+	}
+	if(inf->color_correction_method!=CCMETHOD_LINEAR && ch==CHANNEL_G) {
+		printmsg(c, "* Warning: -quant may not work with -srgb, -bt709, or -gamma\n");
+	}
+
+	if(!rs_lineimg_find_quant(&c->res[idx][ch],c->stream_step,q)) {
+		if(ch==CHANNEL_G) {
+			printmsg(c, "* Warning: Not enough filter weights to test for quantization\n");
+		}
+		return;
+	}
+	c->quant_valid[idx][ch] = 1;
+
+	if(c->channels_rgb)
+		my_snprintf(label, sizeof(label), " (%s)", channel_name(ch));
+	else
+		label[0] = '\0';
+
+	if(q->bits>0) {
+		printmsg(c, "  Weight precision%s: %d bits (confidence %.4f, %d weights)\n",
+			label,q->bits,q->confidence,q->num_weights);
+	}
+	else {
+		printmsg(c, "  Weight precision%s: no quantization detected, down to %d bits\n",
+			label,q->max_bits);
+	}
+}
+
+// Estimates the number of filter phases for c->res[idx][ch], and prints it.
+static void phases_result(struct context *c, int idx, int ch)
+{
+	struct rs_phases *ph = &c->phases[idx][ch];
+	double t0;
+	char label[10];
+
+	if(c->res[idx][ch].pattern!=PATTERN_DOTIMG) {
+		if(ch==CHANNEL_G) {
+			printmsg(c, "* Warning: -phases only works with the dot pattern\n");
+		}
+		return;
+	}
+
+	t0 = timer_now();
+	if(!rs_dotimg_find_phases(&c->res[idx][ch],cli_parallel_for,(void*)c,ph)) {
+		printmsg(c, "* Warning: Failed to test for filter phases\n");
+		return;
+	}
+	timing_add(c,STAGE_ANALYZE,t0,0.0);
+	c->phases_valid[idx][ch] = 1;
+
+	if(c->channels_rgb)
+		my_snprintf(label, sizeof(label), " (%s)", channel_name(ch));
+	else
+		label[0] = '\0';
+
+	if(ph->phases>0) {
+		printmsg(c, "  Filter phases%s: %d per source pixel (confidence %.4f, snapping error %.6f)\n",
+			label,ph->phases,ph->confidence,ph->snap_error);
+	}
+	else {
+		printmsg(c, "  Filter phases%s: not detected, up to %d\n",label,ph->max_phases);
+	}
+}
+
+// Analyze input file number 'idx', and graph it if we're making a graph.
+// The results are saved in c->res[idx].
+static int run_1file(struct context *c, int idx, int pattern)
+{
+	struct infile_info *inf = &c->inf[idx];
+	struct rsg_style st;
+	char namebuf[100];
+	char chnamebuf[110];
+	double t0;
+	int ch;
+	int ret;
+	// Colors for each channel with -channels rgb: for the primary file, and
+	// lighter ones for the secondary file.
+	static const int channel_colors[2][NUM_CHANNELS][3] = {
+		{ { 224, 0, 0 }, { 0, 160, 0 }, { 0, 0, 255 } },
+		{ { 255, 144, 144 }, { 128, 208, 128 }, { 144, 144, 255 } }
+	};
+
+	ret = analyze_file(c,inf,pattern,c->res[idx],c->res_valid[idx]);
+
+	for(ch=0;ch<NUM_CHANNELS;ch++) {
+		if(!channel_used(c,ch)) continue;
+
+		if(c->identify && c->res_valid[idx][ch]) {
+			identify_result(c,idx,ch);
+		}
+		if(c->find_quant && c->res_valid[idx][ch]) {
+			quant_result(c,idx,ch,inf);
+		}
+		if(c->find_phases && c->res_valid[idx][ch]) {
+			phases_result(c,idx,ch);
+		}
+
+		if(!rsg_is_drawing(&c->gr) || !c->res_valid[idx][ch]) {
+			rsg_skip(&c->gr);
+			continue;
+		}
+
+		t0 = timer_now();
+		st.name = get_inf_name(inf,namebuf,sizeof(namebuf));
+		st.thicklines = inf->thicklines;
+		st.color_r = inf->color_r;
+		st.color_g = inf->color_g;
+		st.color_b = inf->color_b;
+		if(c->channels_rgb) {
+			my_snprintf(chnamebuf, sizeof(chnamebuf), "%s %s", st.name, channel_name(ch));
+			st.name = chnamebuf;
+			st.color_r = channel_colors[idx][ch][0];
+			st.color_g = channel_colors[idx][ch][1];
+			st.color_b = channel_colors[idx][ch][2];
+		}
+		rsg_plot(&c->gr,&st,&c->res[idx][ch]);
+		timing_add(c,STAGE_RENDER,t0,0.0);
+	}
+
+	return ret;
+}
+
+static int is_graph_format(int fmt)
+{
+	return fmt==OUTFMT_PNG || fmt==OUTFMT_SVG || fmt==OUTFMT_PNM;
+}
+
+static int run_analysis(struct context *c, int pattern)
+{
+	int ret = 1;
+	int i, ch;
+	double t0;
+
+	printmsg(c, "Writing %s [%s pattern]\n",c->outfn,
+		(pattern==PATTERN_DOTIMG)?"dot":"line");
+
+	if(is_graph_format(c->output_format)) {
+		t0 = timer_now();
+		c->gr.svg = (c->output_format==OUTFMT_SVG);
+		rsg_begin(&c->gr,pattern);
+		timing_add(c,STAGE_RENDER,t0,0.0);
+	}
+
+	if(c->inf[1].fn) {
+		if(!run_1file(c,1,pattern)) ret = 0;
+	}
 
-	printmsg(c, "Writing %s [line pattern]\n",c->outfn);
+	if(!run_1file(c,0,pattern)) ret = 0;
 
-	gr_init(c);
-	c->border_color = gdImageColorResolve(c->im_out,204,136,204);
-	gr_draw_grid(c);
-	gr_draw_logo(c);
+	if(is_graph_format(c->output_format)) {
+		if(!gr_done(c)) ret = 0;
+	}
+	else {
+		if(!write_data_file(c,c->outfn,c->output_format)) ret = 0;
+	}
 
-	if(c->inf[1].fn) {
-		c->curr_color = gdImageColorResolve(c->im_out,
-		  c->inf[1].color_r,c->inf[1].color_g,c->inf[1].color_b);
-		ret = run_lineimg_1file(c,&c->inf[1]);
-		c->lastpos_set = 0;
+	if(c->datafn) {
+		if(!write_data_file(c,c->datafn,data_format_from_fn(c->datafn))) ret = 0;
 	}
 
-	c->curr_color = gdImageColorResolve(c->im_out,
-	  c->inf[0].color_r,c->inf[0].color_g,c->inf[0].color_b);
-	ret = run_lineimg_1file(c,&c->inf[0]);
+	if(c->kernelfn) {
+		if(!write_kernel_file(c,c->kernelfn)) ret = 0;
+	}
 
-	gr_done(c);
+	for(i=0;i<2;i++) {
+		for(ch=0;ch<NUM_CHANNELS;ch++) {
+			if(c->res_valid[i][ch]) {
+				rs_result_free(&c->res[i][ch]);
+				c->res_valid[i][ch] = 0;
+			}
+			c->num_matches[i][ch] = 0;
+			c->quant_valid[i][ch] = 0;
+			c->phases_valid[i][ch] = 0;
+		}
+	}
 	return ret;
 }
 
@@ -932,45 +2081,49 @@ static int run_us(struct context *c)
 
 /////////////// FILE GENERATION ///////////////
 
-static int gen_dotimg_image(struct context *c)
+// Writes the source image for the given pattern to a PNG (or PGM) file. The
+// rows are generated as they are written.
+static int write_pattern_image(struct context *c, int pattern, const char *fn)
 {
-	int i,j;
-	gdImagePtr im = NULL;
-	FILE *w = NULL;
-	int clr_gray, clr_white;
-	int clr;
-	int retval=0;
-	const char *fn;
+	struct image_writer iw;
+	int tmp;
+	int width, height;
+	int j;
+	int ok;
+	unsigned char *row = NULL;
+
+	rs_pattern_size(pattern,&width,&height);
+	if(c->rotated) {
+		tmp = width; width = height; height = tmp;
+	}
 
-	fn = c->rotated ? "pdr.png" : "pd.png";
+	row = malloc((size_t)width);
+	if(!row) {
+		printmsg(c, "* Error: Out of memory\n");
+		return 0;
+	}
 
-	w = my_fopen(fn,"wb");
-	if(!w) {
-		printmsg(c, "Can't write %s\n",fn);
-		goto done;
+	ok = iw_open(c,&iw,fn,c->output_format==OUTFMT_PNM,width,height,NULL,0);
+	for(j=0; ok && j<height; j++) {
+		rs_gen_pattern_row(pattern,c->rotated,j,row);
+		ok = iw_write_row(c,&iw,row);
 	}
+	ok = iw_close(c,&iw,ok);
+	free(row);
+	return ok;
+}
 
-	if(c->rotated)
-		im = gdImageCreateTrueColor(DOTIMG_SRC_HEIGHT,DOTIMG_SRC_WIDTH);
-	else
-		im = gdImageCreateTrueColor(DOTIMG_SRC_WIDTH,DOTIMG_SRC_HEIGHT);
+static int gen_dotimg_image(struct context *c)
+{
+	const char *fn;
 
-	clr_gray = gdImageColorResolve(im,50,50,50);
-	clr_white = gdImageColorResolve(im,250,250,250);
+	if(c->output_format==OUTFMT_PNM)
+		fn = c->rotated ? "pdr.pgm" : "pd.pgm";
+	else
+		fn = c->rotated ? "pdr.png" : "pd.png";
 
-	for(j=0;j<DOTIMG_SRC_HEIGHT;j++) {
-		for(i=0;i<DOTIMG_SRC_WIDTH;i++) {
-			clr = clr_gray;
-			if((j%DOTIMG_STRIPHEIGHT==DOTIMG_VCENTER) && (i>=DOTIMG_HCENTER) && (i<DOTIMG_SRC_WIDTH-DOTIMG_HCENTER)) {
-				if((i-j/DOTIMG_STRIPHEIGHT)%DOTIMG_HPIXELSPAN == DOTIMG_HCENTER) {
-					clr = clr_white;
-				}
-			}
-			rs_gdImageSetPixel(c,im,i,j,clr);
-		}
-	}
+	if(!write_pattern_image(c,PATTERN_DOTIMG,fn)) return 0;
 
-	gdImagePng(im,w);
 	if(c->rotated) {
 		printmsg(c, "Wrote %s (%dx%d - resize to %dx%d)\n",fn,
 		  DOTIMG_SRC_HEIGHT,DOTIMG_SRC_WIDTH,
@@ -981,52 +2134,19 @@ static int gen_dotimg_image(struct context *c)
 		  DOTIMG_SRC_WIDTH,DOTIMG_SRC_HEIGHT,
 		  DOTIMG_DST_WIDTH,DOTIMG_DST_HEIGHT);
 	}
-
-	retval=1;
-done:
-	if(im) gdImageDestroy(im);
-	if(w) fclose(w);
-	return retval;
+	return 1;
 }
 
 static int gen_lineimg_image(struct context *c)
 {
-	int i,j;
-	gdImagePtr im = NULL;
-	FILE *w = NULL;
-	int clr_black, clr_white;
-	int clr;
-	int retval=0;
-	int middle;
 	const char *fn;
 
-	fn = c->rotated ? "plr.png" : "pl.png";
-
-	w = my_fopen(fn,"wb");
-	if(!w) {
-		printmsg(c, "Can't write %s\n",fn);
-		goto done;
-	}
-
-	if(c->rotated)
-		im = gdImageCreateTrueColor(LINEIMG_SRC_HEIGHT,LINEIMG_SRC_WIDTH);
+	if(c->output_format==OUTFMT_PNM)
+		fn = c->rotated ? "plr.pgm" : "pl.pgm";
 	else
-		im = gdImageCreateTrueColor(LINEIMG_SRC_WIDTH,LINEIMG_SRC_HEIGHT);
-
-	clr_black = gdImageColorResolve(im,50,50,50);
-	clr_white = gdImageColorResolve(im,250,250,250);
-
-	middle = LINEIMG_SRC_WIDTH / 2;
-
-	for(j=0;j<LINEIMG_SRC_HEIGHT;j++) {
-		for(i=0;i<LINEIMG_SRC_WIDTH;i++) {
-			if(i==middle) clr = clr_white;
-			else clr = clr_black;
-			rs_gdImageSetPixel(c,im,i,j,clr);
-		}
-	}
+		fn = c->rotated ? "plr.png" : "pl.png";
 
-	gdImagePng(im,w);
+	if(!write_pattern_image(c,PATTERN_LINEIMG,fn)) return 0;
 
 	if(c->rotated) {
 		printmsg(c, "Wrote %s (%dx%d - resize to %dx%d)\n",fn,
@@ -1038,12 +2158,7 @@ static int gen_lineimg_image(struct context *c)
 		  LINEIMG_SRC_WIDTH,LINEIMG_SRC_HEIGHT,
 		  LINEIMG_DST_WIDTH,LINEIMG_DST_HEIGHT);
 	}
-
-	retval=1;
-done:
-	if(im) gdImageDestroy(im);
-	if(w) fclose(w);
-	return retval;
+	return 1;
 }
 
 static void gen_html(struct context *c)
@@ -1104,7 +2219,8 @@ static void gen_source_images(struct context *c)
 {
 	gen_lineimg_image(c);
 	gen_dotimg_image(c);
-	gen_html(c);
+	// Web browsers can't display PGM files.
+	if(c->output_format!=OUTFMT_PNM) gen_html(c);
 }
 
 ///////////////////////////////////////////////
@@ -1113,22 +2229,11 @@ static void gen_source_images(struct context *c)
 // On error, prints an error message and returns 0.
 static int detect_image_type(struct context *c, const char *fn)
 {
-	int w;
-	int i;
-
 	if(!open_file_for_reading(c,fn)) return 0;
+	if(!decode_image(c,fn,&c->inf[0],0)) return 0;
 	//printmsg(c, "Autodetecting %s\n",fn);
 
-	w = rs_gdImageSX(c,c->im_in);
-
-	// Look at the top row. If it contains any bright pixels, assume PATTERN_LINEIMG.
-	// Otherwise, assume PATTERN_DOTIMG
-	for(i=0;i<w;i++) {
-		if(rs_gdImageGetPixel(c, &c->inf[0], c->im_in, i, 0)>=99.9)
-			return PATTERN_LINEIMG;
-	}
-
-	return PATTERN_DOTIMG;
+	return rs_stream_detect_pattern(&c->stream[CHANNEL_G]);
 }
 
 ///////////////////////////////////////////////
@@ -1142,12 +2247,24 @@ static void usage(struct context *c, const char *prg)
 	printmsg(c, "     Generate the source image files\n");
 	printmsg(c, "  %s [options] <image-file.png> [<secondary-image-file.png>] <output-file.png>\n",prg);
 	printmsg(c, "     Analyze a resized image file\n");
+	printmsg(c, "  %s [options] -batch <file.txt>\n",prg);
+	printmsg(c, "     Analyze many files. Each line of file.txt has the options and file\n");
+	printmsg(c, "     names for one graph, in the same format as the command line\n");
+	printmsg(c, "     Use -j <n> to run <n> jobs at once (0 = one per processor)\n");
+	printmsg(c, "  %s [options] -simulate <filter> <width> [<secondary-image-file.png>] <output-file.png>\n",prg);
+	printmsg(c, "     Resize the pattern to <width> pixels with a built-in filter, and analyze it\n");
+	printmsg(c, "     Filters: box triangle catmullrom mitchell bspline hermite cubic:<B>,<C>\n");
+	printmsg(c, "       lanczos[<N>] gaussian[:<sigma>]\n");
+	printmsg(c, "  A file name of - means standard input (for one image file) or standard output\n");
 	printmsg(c, " Options:\n");
 	printmsg(c, "  -pd             - Assume the \"dots pattern\" source image was used\n");
 	printmsg(c, "  -pl             - Assume the \"lines pattern\" source image was used\n");
 	printmsg(c, "  -sf <factor>    - Assume image-file.png's features were scaled by this factor\n");
 	printmsg(c, "  -ff <factor>    - Multiply image-file.png's assumed scale factor by this factor\n");
+	printmsg(c, "  -ff auto        - Search for the factor that makes the dot pattern graph smoothest\n");
 	printmsg(c, "  -srgb           - For image-file.png, assume an sRGB-colorspace-aware resize was performed\n");
+	printmsg(c, "  -bt709          - Like -srgb, but for the BT.709 transfer function\n");
+	printmsg(c, "  -gamma <g>      - Like -srgb, but for a pure power-law curve (e.g. 2.2)\n");
 	printmsg(c, "  -r              - Swap the x and y dimensions, to test the vertical direction\n");
 	printmsg(c, "  -range[2]       - Shrink the graph, to increase the visible vertical range\n");
 	printmsg(c, "  -thick1         - Graph image-file.png using thicker lines\n");
@@ -1155,6 +2272,27 @@ static void usage(struct context *c, const char *prg)
 	printmsg(c, "  -nologo         - Don't include the program name in output-file.png\n");
 	printmsg(c, "  -name <name>    - Friendly name for image-file.png\n");
 	printmsg(c, "  -name2 <name>   - Friendly name for secondary-image-file.png\n");
+	printmsg(c, "  -o <fmt>        - Format of output-file: png, svg, or pnm (graph), csv, json,\n");
+	printmsg(c, "                    or bin (data). With -gen, pnm writes PGM files\n");
+	printmsg(c, "  -zlevel <n>     - Compression level of PNG files, 0 (none) to 9 (best)\n");
+	printmsg(c, "  -data <file>    - Also write the data to this file (.csv, .json, or .bin)\n");
+	printmsg(c, "  -timing         - Report the time taken by each stage of processing\n");
+	printmsg(c, "  -size <W>x<H>   - Size of image files that are headerless raw pixels\n");
+	printmsg(c, "  -format <fmt>   - Format of raw image files: gray8 rgb8 rgba8 gray16\n");
+	printmsg(c, "  -channels rgb   - Analyze the red, green, and blue channels separately\n");
+	printmsg(c, "  -identify       - Find the known filters that best match the graph\n");
+	printmsg(c, "  -threshold <t>  - Ignore smaller values when finding the filter's support (default 0.01)\n");
+	printmsg(c, "  -quant          - Estimate the precision of the filter weights (line pattern only)\n");
+	printmsg(c, "  -phases         - Estimate the number of filter phases used (dot pattern only)\n");
+	printmsg(c, "  -export-kernel <file.h> - Write the filter as C tables of polyphase weights\n");
+	printmsg(c, "  -kphases <n>    - With -export-kernel, the number of phases (default 64)\n");
+	printmsg(c, "  -kbits <n>      - With -export-kernel, fractional bits of the fixed-point weights\n"
+		"                    (default 14; 0 for none)\n");
+	printmsg(c, "  -kscale <s>     - With -export-kernel, the scale factor for the weights\n"
+		"                    (default: that of image-file.png)\n");
+	printmsg(c, "  -simsrgb        - With -simulate, resize in a linear colorspace, assuming sRGB\n");
+	printmsg(c, "  -simout <file>  - With -simulate, also save the resized pattern to a PNG file\n");
+	printmsg(c, "                    (or PGM, if the name ends in .pgm)\n");
 }
 
 static void init_ctx_lowlevel(struct context *c)
@@ -1164,7 +2302,8 @@ static void init_ctx_lowlevel(struct context *c)
 
 static void init_ctx_highlevel(struct context *c)
 {
-	c->include_logo = 1;
+	c->gr.include_logo = 1;
+	c->zlevel = RSPNG_DEFAULT_LEVEL;
 
 	c->inf[0].color_r = 0;
 	c->inf[0].color_g = 0;
@@ -1173,42 +2312,45 @@ static void init_ctx_highlevel(struct context *c)
 	c->inf[1].color_g = 64;
 	c->inf[1].color_b = 64;
 
-	c->srgb50_as_lin1 = srgb_to_linear(50.0/255.0);
-	c->srgb_250_as_lin1 = srgb_to_linear(250.0/255.0);
+	c->kernel_phases = 64;
+	c->kernel_bits = 14;
 }
 
-static int main2(struct context *c, int argc, char **argv)
-{
-	const char *param1 = NULL;
-	const char *param2 = NULL;
-	const char *param3 = NULL;
-	int i;
-	int paramcount;
-	const char *prg;
 #define OP_GEN      1
 #define OP_ANALYZE  2
-	int op = 0;
-	int pattern = 0;
-
-	prg = (argc>=1)?argv[0]:"rscope";
 
-	init_ctx_highlevel(c);
+// The parsed command line (or one line of a batch file).
+struct cmdline {
+	int op;
+	int pattern;
+	int paramcount;
+	const char *param[3];
+	const char *batchfn;
+	int nthreads; // 0 = one per processor
+	int nthreads_set;
+};
 
-	paramcount=0;
+// Parses argv[first] through argv[argc-1]. Options are recorded in c, and
+// everything else in cl.
+// On error, prints an error message and returns 0.
+static int parse_args(struct context *c, struct cmdline *cl, int argc, char **argv,
+	int first)
+{
+	int i, j;
 
-	i=1;
+	i=first;
 	while(i<argc) {
-		if(argv[i][0]=='-') {
+		if(argv[i][0]=='-' && !is_stdio_name(argv[i])) {
 			if(!strcmp(argv[i],"-gen")) {
-				op = OP_GEN;
+				cl->op = OP_GEN;
 			}
 			else if(!strcmp(argv[i],"-pd")) {
-				op = OP_ANALYZE;
-				pattern = PATTERN_DOTIMG;
+				cl->op = OP_ANALYZE;
+				cl->pattern = PATTERN_DOTIMG;
 			}
 			else if(!strcmp(argv[i],"-pl")) {
-				op = OP_ANALYZE;
-				pattern = PATTERN_LINEIMG;
+				cl->op = OP_ANALYZE;
+				cl->pattern = PATTERN_LINEIMG;
 			}
 			else if(!strcmp(argv[i],"-r")) {
 				c->rotated = 1;
@@ -1222,26 +2364,52 @@ static int main2(struct context *c, int argc, char **argv)
 				i++;
 			}
 			else if((i<argc-1) && !strcmp(argv[i],"-sf")) {
-				c->inf[0].scale_factor_req = atof(argv[i+1]);
-				c->inf[0].scale_factor_req_set = 1;
+				c->inf[0].params.scale_factor_req = atof(argv[i+1]);
+				if(!(c->inf[0].params.scale_factor_req>0.0)) {
+					printmsg(c, "Invalid scale factor: %s\n", argv[i+1]);
+					return 0;
+				}
+				c->inf[0].params.scale_factor_req_set = 1;
 				i++;
 			}
 			else if((i<argc-1) && !strcmp(argv[i],"-ff")) {
-				c->inf[0].scale_fudge_factor_req = atof(argv[i+1]);
-				c->inf[0].scale_fudge_factor_req_set = 1;
+				if(!strcmp(argv[i+1],"auto")) {
+					c->inf[0].auto_ff = 1;
+				}
+				else {
+					c->inf[0].auto_ff = 0;
+					c->inf[0].params.scale_fudge_factor_req = atof(argv[i+1]);
+					if(!(c->inf[0].params.scale_fudge_factor_req>0.0)) {
+						printmsg(c, "Invalid fudge factor: %s\n", argv[i+1]);
+						return 0;
+					}
+					c->inf[0].params.scale_fudge_factor_req_set = 1;
+				}
 				i++;
 			}
 			else if(!strcmp(argv[i],"-srgb")) {
 				c->inf[0].color_correction_method = CCMETHOD_SRGB;
 			}
+			else if(!strcmp(argv[i],"-bt709")) {
+				c->inf[0].color_correction_method = CCMETHOD_BT709;
+			}
+			else if((i<argc-1) && !strcmp(argv[i],"-gamma")) {
+				c->inf[0].color_correction_method = CCMETHOD_GAMMA;
+				c->inf[0].gamma = atof(argv[i+1]);
+				if(c->inf[0].gamma<=0.0) {
+					printmsg(c, "Invalid gamma: %s\n", argv[i+1]);
+					return 0;
+				}
+				i++;
+			}
 			else if(!strcmp(argv[i],"-nologo")) {
-				c->include_logo=0;
+				c->gr.include_logo=0;
 			}
 			else if(!strcmp(argv[i],"-range")) {
-				c->expandrange=1;
+				c->gr.expandrange=1;
 			}
 			else if(!strcmp(argv[i],"-range2")) {
-				c->expandrange=2;
+				c->gr.expandrange=2;
 			}
 			else if(!strcmp(argv[i],"-thick1")) {
 				c->inf[0].thicklines = 1;
@@ -1251,23 +2419,180 @@ static int main2(struct context *c, int argc, char **argv)
 				// Use a lighter color for thick lines.
 				c->inf[1].color_r=255; c->inf[1].color_g=128; c->inf[1].color_b=128;
 			}
+			else if((i<argc-1) && !strcmp(argv[i],"-o")) {
+				if(!strcmp(argv[i+1],"png")) c->output_format = OUTFMT_PNG;
+				else if(!strcmp(argv[i+1],"csv")) c->output_format = OUTFMT_CSV;
+				else if(!strcmp(argv[i+1],"json")) c->output_format = OUTFMT_JSON;
+				else if(!strcmp(argv[i+1],"bin")) c->output_format = OUTFMT_BIN;
+				else if(!strcmp(argv[i+1],"svg")) c->output_format = OUTFMT_SVG;
+				else if(!strcmp(argv[i+1],"pnm")) c->output_format = OUTFMT_PNM;
+				else {
+					printmsg(c, "Unknown output format: %s\n", argv[i+1]);
+					return 0;
+				}
+				i++;
+			}
+			else if((i<argc-1) && !strcmp(argv[i],"-zlevel")) {
+				c->zlevel = atoi(argv[i+1]);
+				if(c->zlevel<0 || c->zlevel>9) {
+					printmsg(c, "Invalid compression level: %s\n", argv[i+1]);
+					return 0;
+				}
+				i++;
+			}
+			else if((i<argc-2) && !strcmp(argv[i],"-simulate")) {
+				c->inf[0].simulate = 1;
+				c->inf[0].sim_filter_name = argv[i+1];
+				if(!rs_filter_from_name(argv[i+1],&c->inf[0].sim_filter)) {
+					printmsg(c, "Unknown filter: %s\n", argv[i+1]);
+					return 0;
+				}
+				c->inf[0].sim_width = atoi(argv[i+2]);
+				if(c->inf[0].sim_width<1) {
+					printmsg(c, "Invalid width: %s\n", argv[i+2]);
+					return 0;
+				}
+				i+=2;
+			}
+			else if((i<argc-1) && !strcmp(argv[i],"-size")) {
+				if(sscanf(argv[i+1],"%dx%d",&c->raw.width,&c->raw.height)!=2 ||
+					c->raw.width<1 || c->raw.height<1)
+				{
+					printmsg(c, "Invalid size: %s\n", argv[i+1]);
+					return 0;
+				}
+				if(!c->raw.format) c->raw.format = RSIN_RAW_GRAY8;
+				i++;
+			}
+			else if((i<argc-1) && !strcmp(argv[i],"-format")) {
+				c->raw.format = rsin_raw_format_from_name(argv[i+1]);
+				if(!c->raw.format) {
+					printmsg(c, "Unknown raw format: %s\n", argv[i+1]);
+					return 0;
+				}
+				i++;
+			}
+			else if((i<argc-1) && !strcmp(argv[i],"-channels")) {
+				if(!strcmp(argv[i+1],"rgb")) {
+					c->channels_rgb = 1;
+				}
+				else if(!strcmp(argv[i+1],"g")) {
+					c->channels_rgb = 0;
+				}
+				else {
+					printmsg(c, "Unknown channels: %s\n", argv[i+1]);
+					return 0;
+				}
+				i++;
+			}
+			else if((i<argc-1) && !strcmp(argv[i],"-threshold")) {
+				for(j=0;j<2;j++) {
+					c->inf[j].params.support_threshold_req = atof(argv[i+1]);
+					c->inf[j].params.support_threshold_req_set = 1;
+				}
+				i++;
+			}
+			else if((i<argc-1) && !strcmp(argv[i],"-export-kernel")) {
+				c->kernelfn = argv[i+1];
+				i++;
+			}
+			else if((i<argc-1) && !strcmp(argv[i],"-kphases")) {
+				c->kernel_phases = atoi(argv[i+1]);
+				if(c->kernel_phases<1 || c->kernel_phases>65536) {
+					printmsg(c, "Invalid number of phases: %s\n", argv[i+1]);
+					return 0;
+				}
+				i++;
+			}
+			else if((i<argc-1) && !strcmp(argv[i],"-kbits")) {
+				c->kernel_bits = atoi(argv[i+1]);
+				if(c->kernel_bits<0 || c->kernel_bits>30) {
+					printmsg(c, "Invalid number of bits: %s\n", argv[i+1]);
+					return 0;
+				}
+				i++;
+			}
+			else if((i<argc-1) && !strcmp(argv[i],"-kscale")) {
+				c->kernel_scale = atof(argv[i+1]);
+				if(c->kernel_scale<=0.0) {
+					printmsg(c, "Invalid scale factor: %s\n", argv[i+1]);
+					return 0;
+				}
+				i++;
+			}
+			else if(!strcmp(argv[i],"-phases")) {
+				c->find_phases = 1;
+			}
+			else if(!strcmp(argv[i],"-quant")) {
+				c->find_quant = 1;
+			}
+			else if(!strcmp(argv[i],"-identify")) {
+				c->identify = 1;
+			}
+			else if(!strcmp(argv[i],"-timing")) {
+				c->timing = 1;
+			}
+			else if(!strcmp(argv[i],"-simsrgb")) {
+				c->inf[0].sim_srgb = 1;
+			}
+			else if((i<argc-1) && !strcmp(argv[i],"-simout")) {
+				c->inf[0].sim_outfn = argv[i+1];
+				i++;
+			}
+			else if((i<argc-1) && !strcmp(argv[i],"-data")) {
+				c->datafn = argv[i+1];
+				i++;
+			}
+			else if((i<argc-1) && !strcmp(argv[i],"-batch")) {
+				cl->batchfn = argv[i+1];
+				i++;
+			}
+			else if((i<argc-1) && !strcmp(argv[i],"-j")) {
+				cl->nthreads = atoi(argv[i+1]);
+				cl->nthreads_set = 1;
+				i++;
+			}
 			else {
 				printmsg(c, "Unknown option: %s\n", argv[i]);
-				return 1;
+				return 0;
 			}
 		}
 		else {
 			// a non-option parameter
-			switch(paramcount) {
-			case 0: param1=argv[i]; break;
-			case 1: param2=argv[i]; break;
-			case 2: param3=argv[i]; break;
+			if(cl->paramcount<3) {
+				cl->param[cl->paramcount] = argv[i];
 			}
-			paramcount++;
+			cl->paramcount++;
 		}
 		i++;
 	}
 
+	return 1;
+}
+
+static int run_cmdline2(struct context *c, struct cmdline *cl)
+{
+	int ret;
+
+	if(c->inf[0].simulate) {
+		// The primary image is simulated, so there is one less file name.
+		if(cl->op==OP_GEN || (cl->paramcount!=1 && cl->paramcount!=2)) {
+			return 2;
+		}
+		if(cl->pattern==0) cl->pattern = PATTERN_DOTIMG;
+
+		my_snprintf(c->inf[0].sim_desc, sizeof(c->inf[0].sim_desc), "%s %d%s",
+			c->inf[0].sim_filter_name, c->inf[0].sim_width,
+			c->inf[0].sim_srgb?" srgb":"");
+		c->inf[0].fn = c->inf[0].sim_desc;
+		if(!c->inf[0].name) c->inf[0].name = c->inf[0].sim_desc;
+		c->inf[1].fn = (cl->paramcount==2) ? cl->param[0] : NULL;
+		c->outfn = cl->param[cl->paramcount-1];
+
+		ret = run_analysis(c,cl->pattern);
+		return ret ? 0 : 1;
+	}
+
 	// Detect the image type (either LINEIMG or DOTIMG).
 	// This will base its detection on whichever file gets read first, which
 	// will be the secondary file if there is one.
@@ -1276,66 +2601,361 @@ static int main2(struct context *c, int argc, char **argv)
 	// If we leave the file open, the next (first) image analysis we do will use
 	// it, instead of opening a new file. So we have to be sure we leave the
 	// correct file open. (Yes, this is ugly.)
-	if(op==0 && (paramcount==2 || paramcount==3)) {
-		op = OP_ANALYZE;
-		pattern = detect_image_type(c,(paramcount==2)?param1:param2);
+	if(cl->op==0 && (cl->paramcount==2 || cl->paramcount==3)) {
+		cl->op = OP_ANALYZE;
+		cl->pattern = detect_image_type(c,(cl->paramcount==2)?cl->param[0]:cl->param[1]);
 
-		if(pattern!=PATTERN_DOTIMG && pattern!=PATTERN_LINEIMG) {
+		if(cl->pattern!=PATTERN_DOTIMG && cl->pattern!=PATTERN_LINEIMG) {
 			close_file_for_reading(c);
 			return 1;
 		}
 	}
 
-	if(op==OP_GEN) {
+	if(cl->op==OP_GEN) {
 		gen_source_images(c);
 		return 0;
 	}
-	else if(op==OP_ANALYZE && pattern==PATTERN_DOTIMG) {
-		if(paramcount==2) {
-			// DOTIMG, 1 input file
-			c->inf[0].fn = param1;
-			c->inf[1].fn = NULL;
-			c->outfn = param2;
-			run_ds(c);
+
+	if(cl->op!=OP_ANALYZE || (cl->paramcount!=2 && cl->paramcount!=3)) {
+		return 2;
+	}
+
+	if(cl->paramcount==2) {
+		// 1 input file
+		c->inf[0].fn = cl->param[0];
+		c->inf[1].fn = NULL;
+		c->outfn = cl->param[1];
+	}
+	else {
+		// 2 input files
+		c->inf[0].fn = cl->param[0];
+		c->inf[1].fn = cl->param[1];
+		c->outfn = cl->param[2];
+	}
+
+	ret = run_analysis(c,cl->pattern);
+
+	return ret ? 0 : 1;
+}
+
+// Performs the operation requested by cl.
+// Returns 0 on success, 1 on error, 2 if the usage message should be printed.
+static int run_cmdline(struct context *c, struct cmdline *cl)
+{
+	int ret;
+
+	timing_begin(c);
+	ret = run_cmdline2(c,cl);
+	timing_end(c,ret!=2);
+	return ret;
+}
+
+// Split a line of a batch file into tokens, in place.
+// Tokens are separated by whitespace, and may be enclosed in double quotes.
+// A '#' at the start of a token begins a comment.
+// Returns the number of tokens, or -1 if there are too many.
+static int tokenize_line(char *line, char **tokens, int max_tokens)
+{
+	int n = 0;
+	char *s = line;
+	char *d;
+
+	while(1) {
+		while(*s==' ' || *s=='\t' || *s=='\r' || *s=='\n') s++;
+		if(*s=='\0' || *s=='#') break;
+
+		if(n>=max_tokens) return -1;
+		tokens[n++] = d = s;
+
+		while(*s!='\0' && *s!=' ' && *s!='\t' && *s!='\r' && *s!='\n') {
+			if(*s=='"') {
+				s++;
+				while(*s!='\0' && *s!='"') *d++ = *s++;
+				if(*s=='"') s++;
+			}
+			else {
+				*d++ = *s++;
+			}
+		}
+		if(*s!='\0') s++;
+		*d = '\0';
+	}
+	return n;
+}
+
+///////////////////////////////////////////////
+
+// One line of a batch file.
+struct batch_job {
+	char *line; // The tokens point into this.
+	int linenum;
+	struct context c;
+	struct cmdline cl;
+	struct msgbuf msgs;
+	int done;
+	int ret; // 0 = success
+};
+
+struct batch_state {
+	const char *fn;
+	struct batch_job *jobs;
+	int num_jobs;
+	int next_job; // The next job to be started
+	struct rs_sync sync;
+};
+
+// Reads the batch file, and parses each line into a job.
+// Jobs that can't be parsed are marked as done, with an error.
+// Returns 0 on error.
+static int read_batch_file(struct context *c, struct batch_state *bs)
+{
+	FILE *f;
+	char line[4096];
+	char *tokens[100];
+	int ntokens;
+	int linenum = 0;
+	int jobs_alloc = 0;
+	int i;
+	struct batch_job *j;
+	struct batch_job *newjobs;
+
+	f = my_fopen(bs->fn,"rb");
+	if(!f) {
+		printmsg(c, "* Error: Failed to read %s\n",bs->fn);
+		return 0;
+	}
+
+	while(fgets(line,sizeof(line),f)) {
+		linenum++;
+
+		if(bs->num_jobs>=jobs_alloc) {
+			jobs_alloc = jobs_alloc ? 2*jobs_alloc : 64;
+			newjobs = realloc(bs->jobs, jobs_alloc*sizeof(struct batch_job));
+			if(!newjobs) {
+				printmsg(c, "* Error: Out of memory\n");
+				fclose(f);
+				return 0;
+			}
+			bs->jobs = newjobs;
+			for(i=0;i<bs->num_jobs;i++) {
+				bs->jobs[i].c.msgs = &bs->jobs[i].msgs;
+			}
 		}
-		else if(paramcount==3) {
-			// DOTIMG, 2 input files
-			c->inf[0].fn = param1;
-			c->inf[1].fn = param2;
-			c->outfn = param3;
-			run_ds(c);
+
+		j = &bs->jobs[bs->num_jobs];
+		memset(j,0,sizeof(struct batch_job));
+		j->linenum = linenum;
+		j->c = *c;
+		j->c.msgs = &j->msgs;
+
+		if(!strchr(line,'\n') && !feof(f)) {
+			printmsg(&j->c, "* Error: %s line %d: Line too long\n",bs->fn,linenum);
+			j->done = 1;
+			j->ret = 1;
+			bs->num_jobs++;
+			// Skip the rest of the line.
+			while(fgets(line,sizeof(line),f) && !strchr(line,'\n')) ;
+			continue;
 		}
-		else {
-			usage(c, prg);
-			return 1;
+
+		j->line = malloc(strlen(line)+1);
+		if(!j->line) {
+			printmsg(c, "* Error: Out of memory\n");
+			fclose(f);
+			return 0;
+		}
+		memcpy(j->line, line, strlen(line)+1);
+
+		ntokens = tokenize_line(j->line,tokens,(int)(sizeof(tokens)/sizeof(tokens[0])));
+		if(ntokens==0) {
+			free(j->line);
+			continue;
+		}
+		bs->num_jobs++;
+
+		if(ntokens<0) {
+			printmsg(&j->c, "* Error: %s line %d: Too many parameters\n",bs->fn,linenum);
+			j->done = 1;
+			j->ret = 1;
+		}
+		else if(!parse_args(&j->c,&j->cl,ntokens,tokens,0)) {
+			printmsg(&j->c, "* Error: %s line %d: Bad command\n",bs->fn,linenum);
+			j->done = 1;
+			j->ret = 1;
+		}
+		else if(j->cl.batchfn) {
+			printmsg(&j->c, "* Error: %s line %d: -batch can't be used in a batch file\n",
+				bs->fn,linenum);
+			j->done = 1;
+			j->ret = 1;
 		}
+		else if(j->cl.nthreads_set) {
+			// The number of jobs comes from the command line that runs the
+			// batch file.
+			printmsg(&j->c, "* Error: %s line %d: -j can't be used in a batch file\n",
+				bs->fn,linenum);
+			j->done = 1;
+			j->ret = 1;
+		}
+	}
+
+	fclose(f);
+	return 1;
+}
+
+static void run_batch_job(struct batch_state *bs, struct batch_job *j)
+{
+	j->ret = run_cmdline(&j->c,&j->cl);
+	if(j->ret==2) {
+		printmsg(&j->c, "* Error: %s line %d: Bad command\n",bs->fn,j->linenum);
 	}
-	else if(op==OP_ANALYZE && pattern==PATTERN_LINEIMG) {
-		if(paramcount==2) {
-			// LINEIMG, 1 input file
-			c->inf[0].fn = param1;
-			c->inf[1].fn = NULL;
-			c->outfn = param2;
-			run_us(c);
+}
+
+// The main function of each worker thread.
+// Each worker has its own graph background cache, and each job has its own
+// context, so the only shared state is the job queue.
+static void batch_worker(void *arg)
+{
+	struct batch_state *bs = (struct batch_state*)arg;
+	struct batch_job *j;
+	struct rsg_cache gcache;
+
+	memset(&gcache,0,sizeof(struct rsg_cache));
+
+	while(1) {
+		rs_sync_lock(&bs->sync);
+		if(bs->next_job>=bs->num_jobs) {
+			rs_sync_unlock(&bs->sync);
+			break;
 		}
-		else if(paramcount==3) {
-			// LINEIMG, 2 input files
-			c->inf[0].fn = param1;
-			c->inf[1].fn = param2;
-			c->outfn = param3;
-			run_us(c);
+		j = &bs->jobs[bs->next_job++];
+		rs_sync_unlock(&bs->sync);
+
+		if(!j->done) {
+			j->c.gr.cache = &gcache;
+			run_batch_job(bs,j);
+			j->c.gr.cache = NULL;
 		}
-		else {
+
+		rs_sync_lock(&bs->sync);
+		j->done = 1;
+		rs_sync_notify(&bs->sync);
+		rs_sync_unlock(&bs->sync);
+	}
+
+	rsg_cache_free(&gcache);
+}
+
+// Run each line of the batch file 'fn' as if it were a separate command line,
+// starting with the options in c.
+// The jobs are distributed among 'nthreads' threads, but the messages are
+// always printed in the order of the lines in the file.
+// Returns 0 if everything succeeded, or 1 if anything failed.
+static int run_batch(struct context *c, const char *fn, int nthreads)
+{
+	struct batch_state bs;
+	struct batch_job *j;
+	struct rsg_cache gcache;
+	rs_thread *threads = NULL;
+	int num_threads_started = 0;
+	int num_errors = 0;
+	int retval = 1;
+	int i;
+
+	memset(&bs,0,sizeof(struct batch_state));
+	bs.fn = fn;
+	memset(&gcache,0,sizeof(struct rsg_cache));
+
+	if(!read_batch_file(c,&bs)) goto done;
+
+	if(nthreads<1) nthreads = rs_num_processors();
+	if(nthreads>bs.num_jobs) nthreads = bs.num_jobs;
+
+	if(nthreads>1) {
+		rs_sync_init(&bs.sync);
+		threads = malloc(nthreads*sizeof(rs_thread));
+		if(threads) {
+			for(i=0;i<nthreads;i++) {
+				if(!rs_thread_create(&threads[num_threads_started],batch_worker,&bs)) break;
+				num_threads_started++;
+			}
+		}
+	}
+
+	for(i=0;i<bs.num_jobs;i++) {
+		j = &bs.jobs[i];
+
+		if(num_threads_started>0) {
+			// Wait for the job to finish.
+			rs_sync_lock(&bs.sync);
+			while(!j->done) {
+				rs_sync_wait(&bs.sync);
+			}
+			rs_sync_unlock(&bs.sync);
+		}
+		else if(!j->done) {
+			j->c.gr.cache = &gcache;
+			run_batch_job(&bs,j);
+		}
+
+		msgbuf_flush(&j->msgs);
+		if(j->ret!=0) num_errors++;
+	}
+
+	if(nthreads>1) {
+		for(i=0;i<num_threads_started;i++) {
+			rs_thread_join(threads[i]);
+		}
+		rs_sync_destroy(&bs.sync);
+	}
+
+	printmsg(c, "Batch: %d command(s), %d error(s)\n",bs.num_jobs,num_errors);
+	retval = num_errors ? 1 : 0;
+
+done:
+	for(i=0;i<bs.num_jobs;i++) {
+		free(bs.jobs[i].line);
+	}
+	free(bs.jobs);
+	free(threads);
+	rsg_cache_free(&gcache);
+	return retval;
+}
+
+static int main2(struct context *c, int argc, char **argv)
+{
+	const char *prg;
+	struct cmdline cl;
+	int nthreads;
+	int ret;
+
+	prg = (argc>=1)?argv[0]:"rscope";
+
+	init_ctx_highlevel(c);
+
+	memset(&cl,0,sizeof(struct cmdline));
+	if(!parse_args(c,&cl,argc,argv,1)) {
+		return 1;
+	}
+
+	if(cl.batchfn) {
+		if(cl.op!=0 || cl.paramcount!=0) {
 			usage(c, prg);
 			return 1;
 		}
+		nthreads = cl.nthreads_set?cl.nthreads:1;
+		// If the jobs run in parallel, the searches within them shouldn't.
+		if(nthreads!=1) c->search_nthreads = 1;
+		return run_batch(c,cl.batchfn,nthreads);
 	}
-	else {
+
+	if(cl.nthreads_set) c->search_nthreads = cl.nthreads;
+	ret = run_cmdline(c,&cl);
+	if(ret==2) {
 		usage(c, prg);
 		return 1;
 	}
-
-	return 0;
+	return ret;
 }
 
 #ifdef RS_WINDOWS
@@ -0,0 +1,283 @@
+// ResampleScope built-in font
+// Copyright (C) 2011-2017 Jason Summers
+
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+// The glyphs are those of the public domain X11 "fixed" 6x13 font, in its
+// ISO 8859-2 (Latin-2) version. This is the same font as gd's 'gdFontSmall'.
+
+#include "rsfont.h"
+
+// 13 bytes per character, one for each row, from the top. The most
+// significant bit is the leftmost pixel.
+static const unsigned char font_small_data[256*13] = {
+	0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00, // 0x00
+	0x00,0x00,0x00,0x00,0x20,0x70,0xf8,0x70,0x20,0x00,0x00,0x00,0x00, // 0x01
+	0x00,0x54,0xa8,0x54,0xa8,0x54,0xa8,0x54,0xa8,0x54,0xa8,0x54,0xa8, // 0x02
+	0x00,0x00,0x00,0xa0,0xa0,0xe0,0xa0,0xa0,0x38,0x10,0x10,0x10,0x00, // 0x03
+	0x00,0x00,0x00,0xe0,0x80,0xc0,0x80,0xb8,0x20,0x30,0x20,0x20,0x00, // 0x04
+	0x00,0x00,0x00,0x70,0x80,0x80,0x70,0x70,0x48,0x70,0x50,0x48,0x00, // 0x05
+	0x00,0x00,0x00,0x80,0x80,0x80,0xe0,0x38,0x20,0x30,0x20,0x20,0x00, // 0x06
+	0x00,0x00,0x60,0x90,0x90,0x60,0x00,0x00,0x00,0x00,0x00,0x00,0x00, // 0x07
+	0x00,0x00,0x00,0x00,0x20,0x20,0xf8,0x20,0x20,0x00,0xf8,0x00,0x00, // 0x08
+	0x00,0x00,0x00,0x88,0xc8,0xa8,0x98,0x88,0x20,0x20,0x20,0x3c,0x00, // 0x09
+	0x00,0x00,0x00,0x88,0x88,0x50,0x20,0x00,0xf8,0x20,0x20,0x20,0x00, // 0x0a
+	0x20,0x20,0x20,0x20,0x20,0x20,0xe0,0x00,0x00,0x00,0x00,0x00,0x00, // 0x0b
+	0x00,0x00,0x00,0x00,0x00,0x00,0xe0,0x20,0x20,0x20,0x20,0x20,0x20, // 0x0c
+	0x00,0x00,0x00,0x00,0x00,0x00,0x3c,0x20,0x20,0x20,0x20,0x20,0x20, // 0x0d
+	0x20,0x20,0x20,0x20,0x20,0x20,0x3c,0x00,0x00,0x00,0x00,0x00,0x00, // 0x0e
+	0x20,0x20,0x20,0x20,0x20,0x20,0xfc,0x20,0x20,0x20,0x20,0x20,0x20, // 0x0f
+	0x00,0x00,0xfc,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00, // 0x10
+	0x00,0x00,0x00,0x00,0xfc,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00, // 0x11
+	0x00,0x00,0x00,0x00,0x00,0x00,0xfc,0x00,0x00,0x00,0x00,0x00,0x00, // 0x12
+	0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0xfc,0x00,0x00,0x00,0x00, // 0x13
+	0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0xfc,0x00,0x00, // 0x14
+	0x20,0x20,0x20,0x20,0x20,0x20,0x3c,0x20,0x20,0x20,0x20,0x20,0x20, // 0x15
+	0x20,0x20,0x20,0x20,0x20,0x20,0xe0,0x20,0x20,0x20,0x20,0x20,0x20, // 0x16
+	0x20,0x20,0x20,0x20,0x20,0x20,0xfc,0x00,0x00,0x00,0x00,0x00,0x00, // 0x17
+	0x00,0x00,0x00,0x00,0x00,0x00,0xfc,0x20,0x20,0x20,0x20,0x20,0x20, // 0x18
+	0x20,0x20,0x20,0x20,0x20,0x20,0x20,0x20,0x20,0x20,0x20,0x20,0x20, // 0x19
+	0x00,0x00,0x00,0x08,0x10,0x20,0x40,0x20,0x10,0x08,0x78,0x00,0x00, // 0x1a
+	0x00,0x00,0x00,0x80,0x40,0x20,0x10,0x20,0x40,0x80,0xf0,0x00,0x00, // 0x1b
+	0x00,0x00,0x00,0x00,0x00,0xf8,0x50,0x50,0x50,0x50,0x90,0x00,0x00, // 0x1c
+	0x00,0x00,0x00,0x00,0x00,0x08,0xf8,0x20,0xf8,0x80,0x00,0x00,0x00, // 0x1d
+	0x00,0x00,0x00,0x30,0x48,0x40,0xe0,0x40,0x40,0x48,0xb0,0x00,0x00, // 0x1e
+	0x00,0x00,0x00,0x00,0x00,0x00,0x20,0x00,0x00,0x00,0x00,0x00,0x00, // 0x1f
+	0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00, // 0x20
+	0x00,0x00,0x00,0x20,0x20,0x20,0x20,0x20,0x20,0x00,0x20,0x00,0x00, // !
+	0x00,0x00,0x00,0x50,0x50,0x50,0x00,0x00,0x00,0x00,0x00,0x00,0x00, // "
+	0x00,0x00,0x00,0x00,0x50,0x50,0xf8,0x50,0xf8,0x50,0x50,0x00,0x00, // #
+	0x00,0x00,0x00,0x20,0x78,0xa0,0xa0,0x70,0x28,0x28,0xf0,0x20,0x00, // $
+	0x00,0x00,0x48,0xa8,0x50,0x10,0x20,0x40,0x50,0xa8,0x90,0x00,0x00, // %
+	0x00,0x00,0x00,0x40,0xa0,0xa0,0x40,0xa0,0x98,0x90,0x68,0x00,0x00, // &
+	0x00,0x00,0x00,0x30,0x20,0x40,0x00,0x00,0x00,0x00,0x00,0x00,0x00, // '
+	0x00,0x00,0x00,0x10,0x20,0x40,0x40,0x40,0x40,0x20,0x10,0x00,0x00, // (
+	0x00,0x00,0x00,0x40,0x20,0x10,0x10,0x10,0x10,0x20,0x40,0x00,0x00, // )
+	0x00,0x00,0x00,0x20,0xa8,0x70,0x20,0x70,0xa8,0x20,0x00,0x00,0x00, // *
+	0x00,0x00,0x00,0x00,0x20,0x20,0xf8,0x20,0x20,0x00,0x00,0x00,0x00, // +
+	0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x30,0x20,0x40,0x00, // ,
+	0x00,0x00,0x00,0x00,0x00,0x00,0x00,0xf8,0x00,0x00,0x00,0x00,0x00, // -
+	0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x30,0x30,0x00,0x00, // .
+	0x00,0x00,0x00,0x08,0x08,0x10,0x10,0x20,0x40,0x40,0x80,0x80,0x00, // /
+	0x00,0x00,0x00,0x20,0x50,0x88,0x88,0x88,0x88,0x50,0x20,0x00,0x00, // 0
+	0x00,0x00,0x00,0x20,0x60,0xa0,0x20,0x20,0x20,0x20,0xf8,0x00,0x00, // 1
+	0x00,0x00,0x00,0x70,0x88,0x08,0x10,0x20,0x40,0x80,0xf8,0x00,0x00, // 2
+	0x00,0x00,0x00,0x70,0x88,0x08,0x30,0x08,0x08,0x88,0x70,0x00,0x00, // 3
+	0x00,0x00,0x00,0x10,0x30,0x50,0x90,0x90,0xf8,0x10,0x10,0x00,0x00, // 4
+	0x00,0x00,0x00,0xf8,0x80,0xf0,0x88,0x08,0x08,0x88,0x70,0x00,0x00, // 5
+	0x00,0x00,0x00,0x38,0x40,0x80,0xf0,0x88,0x88,0x88,0x70,0x00,0x00, // 6
+	0x00,0x00,0x00,0xf8,0x08,0x10,0x10,0x20,0x20,0x40,0x40,0x00,0x00, // 7
+	0x00,0x00,0x00,0x70,0x88,0x88,0x70,0x88,0x88,0x88,0x70,0x00,0x00, // 8
+	0x00,0x00,0x00,0x70,0x88,0x88,0x88,0x78,0x08,0x10,0xe0,0x00,0x00, // 9
+	0x00,0x00,0x00,0x00,0x00,0x30,0x30,0x00,0x00,0x30,0x30,0x00,0x00, // :
+	0x00,0x00,0x00,0x00,0x00,0x30,0x30,0x00,0x00,0x30,0x20,0x40,0x00, // ;
+	0x00,0x00,0x08,0x10,0x20,0x40,0x80,0x40,0x20,0x10,0x08,0x00,0x00, // <
+	0x00,0x00,0x00,0x00,0x00,0xf8,0x00,0x00,0xf8,0x00,0x00,0x00,0x00, // =
+	0x00,0x00,0x80,0x40,0x20,0x10,0x08,0x10,0x20,0x40,0x80,0x00,0x00, // >
+	0x00,0x00,0x00,0x70,0x88,0x08,0x10,0x20,0x20,0x00,0x20,0x00,0x00, // ?
+	0x00,0x00,0x00,0x70,0x88,0x98,0xa8,0xa8,0xb0,0x80,0x78,0x00,0x00, // @
+	0x00,0x00,0x00,0x20,0x50,0x88,0x88,0xf8,0x88,0x88,0x88,0x00,0x00, // A
+	0x00,0x00,0x00,0xf0,0x88,0x88,0xf0,0x88,0x88,0x88,0xf0,0x00,0x00, // B
+	0x00,0x00,0x00,0x70,0x88,0x80,0x80,0x80,0x80,0x88,0x70,0x00,0x00, // C
+	0x00,0x00,0x00,0xf0,0x88,0x88,0x88,0x88,0x88,0x88,0xf0,0x00,0x00, // D
+	0x00,0x00,0x00,0xf8,0x80,0x80,0xf0,0x80,0x80,0x80,0xf8,0x00,0x00, // E
+	0x00,0x00,0x00,0xf8,0x80,0x80,0xf0,0x80,0x80,0x80,0x80,0x00,0x00, // F
+	0x00,0x00,0x00,0x70,0x88,0x80,0x80,0x98,0x88,0x88,0x70,0x00,0x00, // G
+	0x00,0x00,0x00,0x88,0x88,0x88,0xf8,0x88,0x88,0x88,0x88,0x00,0x00, // H
+	0x00,0x00,0x00,0x70,0x20,0x20,0x20,0x20,0x20,0x20,0x70,0x00,0x00, // I
+	0x00,0x00,0x00,0x10,0x10,0x10,0x10,0x10,0x10,0x90,0x60,0x00,0x00, // J
+	0x00,0x00,0x00,0x88,0x88,0x90,0xa0,0xe0,0x90,0x88,0x88,0x00,0x00, // K
+	0x00,0x00,0x00,0x80,0x80,0x80,0x80,0x80,0x80,0x80,0xf8,0x00,0x00, // L
+	0x00,0x00,0x00,0x88,0xd8,0xa8,0xa8,0x88,0x88,0x88,0x88,0x00,0x00, // M
+	0x00,0x00,0x00,0x88,0xc8,0xc8,0xa8,0xa8,0x98,0x98,0x88,0x00,0x00, // N
+	0x00,0x00,0x00,0x70,0x88,0x88,0x88,0x88,0x88,0x88,0x70,0x00,0x00, // O
+	0x00,0x00,0x00,0xf0,0x88,0x88,0x88,0xf0,0x80,0x80,0x80,0x00,0x00, // P
+	0x00,0x00,0x00,0x70,0x88,0x88,0x88,0x88,0x88,0xa8,0x70,0x08,0x00, // Q
+	0x00,0x00,0x00,0xf0,0x88,0x88,0x88,0xf0,0xa0,0x90,0x88,0x00,0x00, // R
+	0x00,0x00,0x00,0x70,0x88,0x80,0x60,0x10,0x08,0x88,0x70,0x00,0x00, // S
+	0x00,0x00,0x00,0xf8,0x20,0x20,0x20,0x20,0x20,0x20,0x20,0x00,0x00, // T
+	0x00,0x00,0x00,0x88,0x88,0x88,0x88,0x88,0x88,0x88,0x70,0x00,0x00, // U
+	0x00,0x00,0x00,0x88,0x88,0x88,0x50,0x50,0x50,0x20,0x20,0x00,0x00, // V
+	0x00,0x00,0x00,0x88,0x88,0xa8,0xa8,0xa8,0xa8,0xd8,0x50,0x00,0x00, // W
+	0x00,0x00,0x00,0x88,0x88,0x50,0x20,0x20,0x50,0x88,0x88,0x00,0x00, // X
+	0x00,0x00,0x00,0x88,0x88,0x50,0x50,0x20,0x20,0x20,0x20,0x00,0x00, // Y
+	0x00,0x00,0x00,0xf8,0x08,0x10,0x20,0x20,0x40,0x80,0xf8,0x00,0x00, // Z
+	0x00,0x00,0x00,0x70,0x40,0x40,0x40,0x40,0x40,0x40,0x70,0x00,0x00, // [
+	0x00,0x00,0x00,0x80,0x80,0x40,0x40,0x20,0x10,0x10,0x08,0x08,0x00, // 0x5c
+	0x00,0x00,0x00,0x70,0x10,0x10,0x10,0x10,0x10,0x10,0x70,0x00,0x00, // ]
+	0x00,0x00,0x20,0x50,0x88,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00, // ^
+	0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0xf8,0x00, // _
+	0x00,0x00,0x00,0x60,0x20,0x10,0x00,0x00,0x00,0x00,0x00,0x00,0x00, // `
+	0x00,0x00,0x00,0x00,0x00,0x70,0x08,0x78,0x88,0x98,0x68,0x00,0x00, // a
+	0x00,0x00,0x00,0x80,0x80,0xb0,0xc8,0x88,0x88,0xc8,0xb0,0x00,0x00, // b
+	0x00,0x00,0x00,0x00,0x00,0x70,0x88,0x80,0x80,0x88,0x70,0x00,0x00, // c
+	0x00,0x00,0x00,0x08,0x08,0x68,0x98,0x88,0x88,0x98,0x68,0x00,0x00, // d
+	0x00,0x00,0x00,0x00,0x00,0x70,0x88,0xf8,0x80,0x80,0x70,0x00,0x00, // e
+	0x00,0x00,0x00,0x30,0x48,0x40,0x40,0xf0,0x40,0x40,0x40,0x00,0x00, // f
+	0x00,0x00,0x00,0x00,0x08,0x70,0x88,0x88,0x70,0x80,0x70,0x88,0x70, // g
+	0x00,0x00,0x00,0x80,0x80,0xb0,0xc8,0x88,0x88,0x88,0x88,0x00,0x00, // h
+	0x00,0x00,0x00,0x20,0x00,0x60,0x20,0x20,0x20,0x20,0x70,0x00,0x00, // i
+	0x00,0x00,0x00,0x10,0x00,0x30,0x10,0x10,0x10,0x10,0x90,0x90,0x60, // j
+	0x00,0x00,0x00,0x80,0x80,0x90,0xa0,0xc0,0xa0,0x90,0x88,0x00,0x00, // k
+	0x00,0x00,0x00,0x60,0x20,0x20,0x20,0x20,0x20,0x20,0x70,0x00,0x00, // l
+	0x00,0x00,0x00,0x00,0x00,0xd0,0xa8,0xa8,0xa8,0xa8,0x88,0x00,0x00, // m
+	0x00,0x00,0x00,0x00,0x00,0xb0,0xc8,0x88,0x88,0x88,0x88,0x00,0x00, // n
+	0x00,0x00,0x00,0x00,0x00,0x70,0x88,0x88,0x88,0x88,0x70,0x00,0x00, // o
+	0x00,0x00,0x00,0x00,0x00,0xb0,0xc8,0x88,0x88,0xc8,0xb0,0x80,0x80, // p
+	0x00,0x00,0x00,0x00,0x00,0x68,0x98,0x88,0x88,0x98,0x68,0x08,0x08, // q
+	0x00,0x00,0x00,0x00,0x00,0xb0,0xc8,0x80,0x80,0x80,0x80,0x00,0x00, // r
+	0x00,0x00,0x00,0x00,0x00,0x70,0x88,0x60,0x10,0x88,0x70,0x00,0x00, // s
+	0x00,0x00,0x00,0x40,0x40,0xf0,0x40,0x40,0x40,0x48,0x30,0x00,0x00, // t
+	0x00,0x00,0x00,0x00,0x00,0x88,0x88,0x88,0x88,0x98,0x68,0x00,0x00, // u
+	0x00,0x00,0x00,0x00,0x00,0x88,0x88,0x88,0x50,0x50,0x20,0x00,0x00, // v
+	0x00,0x00,0x00,0x00,0x00,0x88,0x88,0xa8,0xa8,0xa8,0x50,0x00,0x00, // w
+	0x00,0x00,0x00,0x00,0x00,0x88,0x50,0x20,0x20,0x50,0x88,0x00,0x00, // x
+	0x00,0x00,0x00,0x00,0x00,0x88,0x88,0x88,0x98,0x68,0x08,0x10,0xe0, // y
+	0x00,0x00,0x00,0x00,0x00,0xf8,0x10,0x20,0x40,0x80,0xf8,0x00,0x00, // z
+	0x00,0x00,0x00,0x18,0x20,0x20,0x20,0xc0,0x20,0x20,0x20,0x18,0x00, // {
+	0x00,0x00,0x00,0x20,0x20,0x20,0x20,0x20,0x20,0x20,0x20,0x20,0x00, // |
+	0x00,0x00,0x00,0xc0,0x20,0x20,0x20,0x18,0x20,0x20,0x20,0xc0,0x00, // }
+	0x00,0x00,0x48,0xa8,0x90,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00, // ~
+	0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00, // 0x7f
+	0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00, // 0x80
+	0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00, // 0x81
+	0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00, // 0x82
+	0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00, // 0x83
+	0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00, // 0x84
+	0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00, // 0x85
+	0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00, // 0x86
+	0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00, // 0x87
+	0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00, // 0x88
+	0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00, // 0x89
+	0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00, // 0x8a
+	0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00, // 0x8b
+	0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00, // 0x8c
+	0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00, // 0x8d
+	0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00, // 0x8e
+	0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00, // 0x8f
+	0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00, // 0x90
+	0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00, // 0x91
+	0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00, // 0x92
+	0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00, // 0x93
+	0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00, // 0x94
+	0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00, // 0x95
+	0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00, // 0x96
+	0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00, // 0x97
+	0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00, // 0x98
+	0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00, // 0x99
+	0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00, // 0x9a
+	0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00, // 0x9b
+	0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00, // 0x9c
+	0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00, // 0x9d
+	0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00, // 0x9e
+	0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00, // 0x9f
+	0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00, // 0xa0
+	0x00,0x00,0x00,0x20,0x50,0x88,0x88,0xf8,0x88,0x88,0x88,0x10,0x0c, // 0xa1
+	0x00,0x88,0x70,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00, // 0xa2
+	0x00,0x00,0x00,0x40,0x40,0x60,0x40,0xc0,0x40,0x40,0x78,0x00,0x00, // 0xa3
+	0x00,0x00,0x00,0x88,0x70,0x50,0x50,0x70,0x88,0x00,0x00,0x00,0x00, // 0xa4
+	0x00,0x00,0x30,0x90,0xa0,0x80,0x80,0x80,0x80,0x80,0xf8,0x00,0x00, // 0xa5
+	0x18,0x60,0x00,0x70,0x88,0x80,0x60,0x10,0x08,0x88,0x70,0x00,0x00, // 0xa6
+	0x00,0x00,0x30,0x48,0x40,0x30,0x48,0x48,0x30,0x08,0x48,0x30,0x00, // 0xa7
+	0x00,0x00,0xd8,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00, // 0xa8
+	0x50,0x20,0x00,0x70,0x88,0x80,0x60,0x10,0x08,0x88,0x70,0x00,0x00, // 0xa9
+	0x00,0x00,0x00,0x70,0x88,0x80,0x60,0x10,0x08,0x88,0x70,0x20,0x40, // 0xaa
+	0x50,0x20,0x00,0xf8,0x20,0x20,0x20,0x20,0x20,0x20,0x20,0x00,0x00, // 0xab
+	0x18,0x60,0x00,0xf8,0x08,0x10,0x20,0x20,0x40,0x80,0xf8,0x00,0x00, // 0xac
+	0x00,0x00,0x00,0x00,0x00,0x00,0xf8,0x00,0x00,0x00,0x00,0x00,0x00, // 0xad
+	0x50,0x20,0x00,0xf8,0x08,0x10,0x20,0x20,0x40,0x80,0xf8,0x00,0x00, // 0xae
+	0x20,0x20,0x00,0xf8,0x08,0x10,0x20,0x20,0x40,0x80,0xf8,0x00,0x00, // 0xaf
+	0x00,0x00,0x30,0x48,0x48,0x30,0x00,0x00,0x00,0x00,0x00,0x00,0x00, // 0xb0
+	0x00,0x00,0x00,0x00,0x00,0x70,0x08,0x78,0x88,0x98,0x68,0x10,0x0c, // 0xb1
+	0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x10,0x20,0x18, // 0xb2
+	0x00,0x00,0x00,0x60,0x20,0x30,0x20,0x60,0x20,0x20,0x70,0x00,0x00, // 0xb3
+	0x00,0x10,0x20,0x40,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00, // 0xb4
+	0x00,0x00,0x0c,0x64,0x28,0x20,0x20,0x20,0x20,0x20,0x70,0x00,0x00, // 0xb5
+	0x00,0x00,0x18,0x60,0x00,0x70,0x88,0x60,0x10,0x88,0x70,0x00,0x00, // 0xb6
+	0x00,0x88,0x50,0x20,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00, // 0xb7
+	0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x20,0x10,0x60, // 0xb8
+	0x00,0x00,0x50,0x20,0x00,0x70,0x88,0x60,0x10,0x88,0x70,0x00,0x00, // 0xb9
+	0x00,0x00,0x00,0x00,0x00,0x70,0x88,0x60,0x10,0x88,0x70,0x20,0x40, // 0xba
+	0x00,0x18,0x08,0x50,0x40,0xf0,0x40,0x40,0x40,0x48,0x30,0x00,0x00, // 0xbb
+	0x00,0x00,0x18,0x60,0x00,0xf8,0x10,0x20,0x40,0x80,0xf8,0x00,0x00, // 0xbc
+	0x00,0x24,0x48,0x90,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00, // 0xbd
+	0x00,0x00,0x50,0x20,0x00,0xf8,0x10,0x20,0x40,0x80,0xf8,0x00,0x00, // 0xbe
+	0x00,0x00,0x20,0x20,0x00,0xf8,0x10,0x20,0x40,0x80,0xf8,0x00,0x00, // 0xbf
+	0x18,0x60,0x00,0xf0,0x88,0x88,0x88,0xf0,0xa0,0x90,0x88,0x00,0x00, // 0xc0
+	0x18,0x60,0x00,0x20,0x50,0x88,0x88,0xf8,0x88,0x88,0x88,0x00,0x00, // 0xc1
+	0x20,0x50,0x88,0x20,0x50,0x88,0x88,0xf8,0x88,0x88,0x88,0x00,0x00, // 0xc2
+	0x88,0x70,0x00,0x20,0x50,0x88,0x88,0xf8,0x88,0x88,0x88,0x00,0x00, // 0xc3
+	0x88,0x88,0x00,0x20,0x50,0x88,0x88,0xf8,0x88,0x88,0x88,0x00,0x00, // 0xc4
+	0x18,0x60,0x00,0x80,0x80,0x80,0x80,0x80,0x80,0x80,0xf8,0x00,0x00, // 0xc5
+	0x18,0x60,0x00,0x70,0x88,0x80,0x80,0x80,0x80,0x88,0x70,0x00,0x00, // 0xc6
+	0x00,0x00,0x00,0x70,0x88,0x80,0x80,0x80,0x80,0x88,0x70,0x10,0x60, // 0xc7
+	0x50,0x20,0x00,0x70,0x88,0x80,0x80,0x80,0x80,0x88,0x70,0x00,0x00, // 0xc8
+	0x18,0x60,0x00,0xf8,0x80,0x80,0xf0,0x80,0x80,0x80,0xf8,0x00,0x00, // 0xc9
+	0x00,0x00,0x00,0xf8,0x80,0x80,0xf0,0x80,0x80,0x80,0xf8,0x20,0x18, // 0xca
+	0x50,0x50,0x00,0xf8,0x80,0x80,0xf0,0x80,0x80,0x80,0xf8,0x00,0x00, // 0xcb
+	0x50,0x20,0x00,0xf8,0x80,0x80,0xf0,0x80,0x80,0x80,0xf8,0x00,0x00, // 0xcc
+	0x18,0x60,0x00,0x70,0x20,0x20,0x20,0x20,0x20,0x20,0x70,0x00,0x00, // 0xcd
+	0x20,0x50,0x00,0x70,0x20,0x20,0x20,0x20,0x20,0x20,0x70,0x00,0x00, // 0xce
+	0x50,0x20,0x00,0xf0,0x88,0x88,0x88,0x88,0x88,0x88,0xf0,0x00,0x00, // 0xcf
+	0x00,0x00,0x00,0xf0,0x48,0x48,0xe8,0x48,0x48,0x48,0xf0,0x00,0x00, // 0xd0
+	0x18,0x60,0x00,0x88,0xc8,0xc8,0xa8,0xa8,0x98,0x98,0x88,0x00,0x00, // 0xd1
+	0x50,0x20,0x00,0x88,0xc8,0xc8,0xa8,0xa8,0x98,0x98,0x88,0x00,0x00, // 0xd2
+	0x18,0x60,0x00,0x70,0x88,0x88,0x88,0x88,0x88,0x88,0x70,0x00,0x00, // 0xd3
+	0x20,0x50,0x00,0x70,0x88,0x88,0x88,0x88,0x88,0x88,0x70,0x00,0x00, // 0xd4
+	0x24,0x48,0x00,0x70,0x88,0x88,0x88,0x88,0x88,0x88,0x70,0x00,0x00, // 0xd5
+	0x50,0x50,0x00,0x70,0x88,0x88,0x88,0x88,0x88,0x88,0x70,0x00,0x00, // 0xd6
+	0x00,0x00,0x00,0x00,0x00,0x88,0x50,0x20,0x50,0x88,0x00,0x00,0x00, // 0xd7
+	0x50,0x20,0x00,0xf0,0x88,0x88,0x88,0xf0,0xa0,0x90,0x88,0x00,0x00, // 0xd8
+	0x20,0x50,0x20,0x88,0x88,0x88,0x88,0x88,0x88,0x88,0x70,0x00,0x00, // 0xd9
+	0x18,0x60,0x00,0x88,0x88,0x88,0x88,0x88,0x88,0x88,0x70,0x00,0x00, // 0xda
+	0x24,0x48,0x00,0x88,0x88,0x88,0x88,0x88,0x88,0x88,0x70,0x00,0x00, // 0xdb
+	0x50,0x50,0x00,0x88,0x88,0x88,0x88,0x88,0x88,0x88,0x70,0x00,0x00, // 0xdc
+	0x18,0x60,0x00,0x88,0x88,0x50,0x50,0x20,0x20,0x20,0x20,0x00,0x00, // 0xdd
+	0x00,0x00,0x00,0xf8,0x20,0x20,0x20,0x20,0x20,0x20,0x20,0x10,0x20, // 0xde
+	0x00,0x00,0x00,0x70,0x88,0x88,0xf0,0x88,0x88,0xc8,0xb0,0x80,0x00, // 0xdf
+	0x00,0x00,0x18,0x60,0x00,0xb0,0xc8,0x80,0x80,0x80,0x80,0x00,0x00, // 0xe0
+	0x00,0x00,0x18,0x60,0x00,0x70,0x08,0x78,0x88,0x98,0x68,0x00,0x00, // 0xe1
+	0x00,0x00,0x20,0x50,0x00,0x70,0x08,0x78,0x88,0x98,0x68,0x00,0x00, // 0xe2
+	0x00,0x00,0x88,0x70,0x00,0x70,0x08,0x78,0x88,0x98,0x68,0x00,0x00, // 0xe3
+	0x00,0x00,0x48,0x48,0x00,0x70,0x08,0x78,0x88,0x98,0x68,0x00,0x00, // 0xe4
+	0x18,0x60,0x00,0x60,0x20,0x20,0x20,0x20,0x20,0x20,0x70,0x00,0x00, // 0xe5
+	0x00,0x00,0x18,0x60,0x00,0x70,0x88,0x80,0x80,0x88,0x70,0x00,0x00, // 0xe6
+	0x00,0x00,0x00,0x00,0x00,0x70,0x88,0x80,0x80,0x88,0x70,0x10,0x60, // 0xe7
+	0x00,0x00,0x50,0x20,0x00,0x70,0x88,0x80,0x80,0x88,0x70,0x00,0x00, // 0xe8
+	0x00,0x00,0x18,0x60,0x00,0x70,0x88,0xf8,0x80,0x80,0x70,0x00,0x00, // 0xe9
+	0x00,0x00,0x00,0x00,0x00,0x70,0x88,0xf8,0x80,0x80,0x70,0x20,0x18, // 0xea
+	0x00,0x00,0x50,0x50,0x00,0x70,0x88,0xf8,0x80,0x80,0x70,0x00,0x00, // 0xeb
+	0x00,0x00,0x50,0x20,0x00,0x70,0x88,0xf8,0x80,0x80,0x70,0x00,0x00, // 0xec
+	0x00,0x00,0x18,0x60,0x00,0x60,0x20,0x20,0x20,0x20,0x70,0x00,0x00, // 0xed
+	0x00,0x00,0x20,0x50,0x00,0x60,0x20,0x20,0x20,0x20,0x70,0x00,0x00, // 0xee
+	0x00,0x0c,0x04,0x18,0x10,0x50,0xb0,0x90,0x90,0x90,0x68,0x00,0x00, // 0xef
+	0x00,0x00,0x08,0x1c,0x08,0x68,0x98,0x88,0x88,0x98,0x68,0x00,0x00, // 0xf0
+	0x00,0x00,0x18,0x60,0x00,0xb0,0xc8,0x88,0x88,0x88,0x88,0x00,0x00, // 0xf1
+	0x00,0x00,0x50,0x20,0x00,0xb0,0xc8,0x88,0x88,0x88,0x88,0x00,0x00, // 0xf2
+	0x00,0x00,0x18,0x60,0x00,0x70,0x88,0x88,0x88,0x88,0x70,0x00,0x00, // 0xf3
+	0x00,0x00,0x20,0x50,0x00,0x70,0x88,0x88,0x88,0x88,0x70,0x00,0x00, // 0xf4
+	0x00,0x00,0x48,0x90,0x00,0x70,0x88,0x88,0x88,0x88,0x70,0x00,0x00, // 0xf5
+	0x00,0x00,0x50,0x50,0x00,0x70,0x88,0x88,0x88,0x88,0x70,0x00,0x00, // 0xf6
+	0x00,0x00,0x00,0x20,0x20,0x00,0xf8,0x00,0x20,0x20,0x00,0x00,0x00, // 0xf7
+	0x00,0x00,0x50,0x20,0x00,0xb0,0xc8,0x80,0x80,0x80,0x80,0x00,0x00, // 0xf8
+	0x00,0x00,0x20,0x50,0x20,0x88,0x88,0x88,0x88,0x98,0x68,0x00,0x00, // 0xf9
+	0x00,0x00,0x18,0x60,0x00,0x88,0x88,0x88,0x88,0x98,0x68,0x00,0x00, // 0xfa
+	0x00,0x00,0x48,0x90,0x00,0x88,0x88,0x88,0x88,0x98,0x68,0x00,0x00, // 0xfb
+	0x00,0x00,0x50,0x50,0x00,0x88,0x88,0x88,0x88,0x98,0x68,0x00,0x00, // 0xfc
+	0x00,0x00,0x18,0x60,0x00,0x88,0x88,0x88,0x98,0x68,0x08,0x10,0xe0, // 0xfd
+	0x00,0x00,0x00,0x40,0x40,0xf0,0x40,0x40,0x40,0x48,0x30,0x10,0x20, // 0xfe
+	0x00,0x00,0x20,0x20,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00 // 0xff
+};
+
+const struct rsr_font rsfont_small = { 256, 0, 6, 13, font_small_data };
@@ -0,0 +1,25 @@
+// ResampleScope built-in font
+// Copyright (C) 2011-2017 Jason Summers
+
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef RSFONT_H
+#define RSFONT_H
+
+#include "rsraster.h"
+
+// A 6x13 font with Latin-2 encoding, used for all text in the graphs.
+extern const struct rsr_font rsfont_small;
+
+#endif // RSFONT_H
@@ -0,0 +1,818 @@
+// ResampleScope graph renderer
+// Copyright (C) 2011-2017 Jason Summers
+
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifdef _MSC_VER
+#define _CRT_SECURE_NO_WARNINGS // For sprintf
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "rsgraph.h"
+#include "rsfont.h"
+
+static unsigned char unicode_to_latin2_char(unsigned int uchar)
+{
+	size_t i;
+	static const unsigned short latin2table[96] = {
+		0x00A0,0x0104,0x02D8,0x0141,0x00A4,0x013D,0x015A,0x00A7, // 160-167
+		0x00A8,0x0160,0x015E,0x0164,0x0179,0x00AD,0x017D,0x017B, // 168-176
+		0x00B0,0x0105,0x02DB,0x0142,0x00B4,0x013E,0x015B,0x02C7, // ...
+		0x00B8,0x0161,0x015F,0x0165,0x017A,0x02DD,0x017E,0x017C,
+		0x0154,0x00C1,0x00C2,0x0102,0x00C4,0x0139,0x0106,0x00C7,
+		0x010C,0x00C9,0x0118,0x00CB,0x011A,0x00CD,0x00CE,0x010E,
+		0x0110,0x0143,0x0147,0x00D3,0x00D4,0x0150,0x00D6,0x00D7,
+		0x0158,0x016E,0x00DA,0x0170,0x00DC,0x00DD,0x0162,0x00DF,
+		0x0155,0x00E1,0x00E2,0x0103,0x00E4,0x013A,0x0107,0x00E7,
+		0x010D,0x00E9,0x0119,0x00EB,0x011B,0x00ED,0x00EE,0x010F,
+		0x0111,0x0144,0x0148,0x00F3,0x00F4,0x0151,0x00F6,0x00F7,
+		0x0159,0x016F,0x00FA,0x0171,0x00FC,0x00FD,0x0163,0x02D9  // 248-255
+	};
+
+	for(i=0; i<96; i++) {
+		if((unsigned int)latin2table[i]==uchar) {
+			return (unsigned char)(160+i);
+		}
+	}
+	return '?';
+}
+
+static void utf8_to_latin2_string(unsigned char *src, unsigned char *dst, size_t dstlen)
+{
+	size_t srcpos, dstpos;
+	unsigned char ch;
+	unsigned int pending_char;
+	int bytes_expected;
+
+	srcpos = 0;
+	dstpos = 0;
+	pending_char = 0;
+	bytes_expected = 0;
+
+	while(1) {
+		if(dstpos >= dstlen-1) {
+			dst[dstlen-1] = '\0';
+			break;
+		}
+
+		ch = src[srcpos++];
+
+		if(ch<128) { // Only byte of a 1-byte sequence
+			dst[dstpos++] = ch;
+			if(ch=='\0') break;
+		}
+		else if(ch<0xc0) { // Continuation byte
+			if(bytes_expected>0) {
+				pending_char = (pending_char<<6)|(ch&0x3f);
+				bytes_expected--;
+				if(bytes_expected<1) {
+					dst[dstpos++] = unicode_to_latin2_char(pending_char);
+				}
+			}
+		}
+		else if(ch<0xe0) { // 1st byte of a 2-byte sequence
+			pending_char = ch&0x1f;
+			bytes_expected=1;
+		}
+		else if(ch<0xf0) { // 1st byte of a 3-byte sequence
+			pending_char = ch&0x0f;
+			bytes_expected=2;
+		}
+		else if(ch<0xf8) { // 1st byte of a 4-byte sequence
+			pending_char = ch&0x07;
+			bytes_expected=3;
+		}
+	}
+}
+
+static void gr_string(struct rs_graph *g, int x, int y,
+	const unsigned char *src_utf8, int color)
+{
+	unsigned char *src_latin2;
+	size_t src_latin2_len;
+
+	src_latin2_len = strlen((const char*)src_utf8) + 1;
+	src_latin2 = malloc(src_latin2_len);
+	if(!src_latin2) return;
+
+	// The font we're using has Latin-2 encoding.
+	// That's not very useful if you're not Eastern European.
+	utf8_to_latin2_string((unsigned char*)src_utf8, src_latin2, src_latin2_len);
+
+	rsr_string(g->im, &rsfont_small, x, y, src_latin2, color);
+	free(src_latin2);
+}
+
+static void gr_init(struct rs_graph *g)
+{
+	g->width = 600;
+	g->zero_x = 230.0;
+	g->unit_x = 90.0;
+
+	g->height = 300;
+	if(g->expandrange==2) {
+		g->zero_y = 260.0;
+		g->unit_y = -90.0;
+	}
+	else if(g->expandrange==1) {
+		g->zero_y = 240.0;
+		g->unit_y = -150.0;
+	}
+	else {
+		g->zero_y = 220.0;
+		g->unit_y = -200.0;
+	}
+
+	g->graph_count = 0;
+	g->lastpos_set = 0;
+}
+
+static int point_is_visible(struct rs_graph *g, int x, int y)
+{
+	if(x<0 || y<0) return 0;
+	if(x>=g->width || y>=g->height) return 0;
+	return 1;
+}
+
+// Convert from logical coordinates to output-image coordinates.
+static int xcoord(struct rs_graph *g, double ix)
+{
+	double physx;
+	physx = g->zero_x + (ix*g->unit_x);
+	return (int)(0.5+physx);
+}
+static int ycoord(struct rs_graph *g, double iy)
+{
+	double physy;
+	physy = g->zero_y + (iy*g->unit_y);
+	return (int)(0.5+physy);
+}
+
+static void gr_draw_grid(struct rs_graph *g)
+{
+	int clr;
+	int i;
+	char tbuf[20];
+
+	clr = rsr_color_resolve(g->im,192,192,192);
+	for(i= -10; i<=10; i++) {
+		// Draw lines for half-integers
+		rsr_dashed_line(g->im,xcoord(g,0.5+(double)i),0,xcoord(g,0.5+(double)i),g->height,clr);
+		rsr_dashed_line(g->im,0,ycoord(g,0.5+(double)i),g->width,ycoord(g,0.5+(double)i),clr);
+	}
+
+	// Draw lines for integers
+	clr = rsr_color_resolve(g->im,192,192,192);
+	for(i= -10; i<=10; i++) {
+		rsr_line(g->im,xcoord(g,i),0,xcoord(g,i),g->height,clr);
+		rsr_line(g->im,0,ycoord(g,i),g->width,ycoord(g,i),clr);
+
+	}
+
+	// Draw x- and y- axes
+	clr = rsr_color_resolve(g->im,0,0,0);
+	rsr_line(g->im,xcoord(g,0.0),0,xcoord(g,0.0),g->height,clr);
+	rsr_line(g->im,0,ycoord(g,0.0),g->width,ycoord(g,0.0),clr);
+
+	// Draw labels
+	clr = rsr_color_resolve(g->im,0,128,0);
+	for(i= 0; i<=1; i++) {
+		sprintf(tbuf, "%d", i);
+		gr_string(g,xcoord(g,i)-6,g->height-14,
+			(unsigned char*)tbuf,clr);
+		gr_string(g,3,ycoord(g,i)-12,
+			(unsigned char*)tbuf,clr);
+	}
+
+	// Draw border around the whole image
+	rsr_rectangle(g->im,0,0,g->width-1,g->height-1,g->border_color);
+}
+
+// Draws a line from the previous point to (xpos,ypos), in output-image
+// coordinates.
+static void gr_lineto(struct rs_graph *g, int xpos, int ypos, int clr)
+{
+	if(g->lastpos_set) {
+		rsr_line(g->im,g->lastpos_x,g->lastpos_y,xpos,ypos,clr);
+	}
+
+	g->lastpos_x = xpos;
+	g->lastpos_y = ypos;
+	g->lastpos_set=1;
+}
+
+// The name for the legend. 's' must have room for 100 bytes.
+static void gr_get_graph_name(const struct rsg_style *st, const struct rs_result *r,
+	char *s)
+{
+	double ff;
+	char tmp[200];
+
+	// The name is limited to 100 bytes, with or without the factor.
+	sprintf(tmp, "%.99s", st->name);
+	ff = r->scale_factor / r->natural_scale_factor;
+	if(ff<0.99999999 || ff>1.00000001) {
+		sprintf(&tmp[strlen(tmp)], " (factor=%.8f)", ff);
+	}
+	memcpy(s, tmp, 100);
+	s[99]='\0';
+}
+
+// The y coordinate of the top of the current graph's entry in the legend.
+static int gr_legend_ypos(struct rs_graph *g)
+{
+	return g->height-19-14*g->graph_count;
+}
+
+static void gr_draw_graph_name(struct rs_graph *g, const struct rsg_style *st,
+	const struct rs_result *r)
+{
+	int ypos;
+	char s[100];
+
+	ypos = gr_legend_ypos(g);
+
+	if(st->thicklines) rsr_set_thickness(g->im,3);
+	rsr_line(g->im,5,ypos+7,13,ypos+7,g->curr_color);
+	rsr_set_thickness(g->im,1);
+
+	gr_get_graph_name(st,r,s);
+	gr_string(g,17,ypos,(unsigned char*)s,g->curr_color);
+}
+
+static void gr_draw_logo(struct rs_graph *g)
+{
+	if(!g->include_logo) return;
+
+	rsr_filled_rectangle(g->im,g->width-81,g->height-15,
+	 g->width-1,g->height-1,g->border_color);
+
+	gr_string(g,g->width-79,g->height-15,
+		(unsigned char*)"ResampleScope",
+		rsr_color_resolve(g->im,255,255,255));
+}
+
+static void gr_get_border_rgb(int pattern, int *r, int *g, int *b)
+{
+	if(pattern==PATTERN_DOTIMG) {
+		*r = 144; *g = 192; *b = 144;
+	}
+	else {
+		*r = 204; *g = 136; *b = 204;
+	}
+}
+
+static void gr_set_border_color(struct rs_graph *g, int pattern)
+{
+	int r, gg, b;
+
+	gr_get_border_rgb(pattern,&r,&gg,&b);
+	g->border_color = rsr_color_resolve(g->im,r,gg,b);
+}
+
+//////////////////// SVG ////////////////////
+
+// An SVG graph has the same layout as the PNG graph, but its coordinates
+// are not rounded, and the curves are drawn directly from the samples.
+
+// Dense samples of the line pattern are reduced to this many envelopes per
+// pixel, which keeps the file small but still looks the same at a high zoom.
+#define SVG_COLUMNS_PER_PIXEL 8
+
+static void svg_append(struct rs_graph *g, const char *s)
+{
+	size_t n;
+	size_t newalloc;
+	char *newdata;
+
+	if(g->svg_nomem) return;
+	n = strlen(s);
+	if(g->svg_len+n+1 > g->svg_alloc) {
+		newalloc = g->svg_alloc*2;
+		if(newalloc < g->svg_len+n+1) newalloc = g->svg_len+n+1;
+		if(newalloc < 4096) newalloc = 4096;
+		newdata = realloc(g->svg_data,newalloc);
+		if(!newdata) {
+			g->svg_nomem = 1;
+			return;
+		}
+		g->svg_data = newdata;
+		g->svg_alloc = newalloc;
+	}
+	memcpy(&g->svg_data[g->svg_len],s,n+1);
+	g->svg_len += n;
+}
+
+// Writes v to buf with 2 decimal places, like "%.2f" (but it may differ in
+// the last digit, for values very close to halfway). This is much faster
+// than sprintf(), which matters for the thousands of points in a graph.
+// buf must have room for 40 bytes.
+static void svg_format_coord(char *buf, double v)
+{
+	char digits[24];
+	long n;
+	int nd = 0;
+	int pos = 0;
+
+	// Larger values would overflow a 32-bit long when scaled by 100.
+	// (This also catches NaN.)
+	if(!(fabs(v)<=2.0e7)) {
+		sprintf(buf, "%.2f", v);
+		return;
+	}
+
+	n = (long)floor(fabs(v)*100.0+0.5);
+	if(v<0.0 && n>0) buf[pos++] = '-';
+	do {
+		digits[nd++] = (char)('0' + n%10);
+		n /= 10;
+	} while(n>0 || nd<3);
+	while(nd>2) buf[pos++] = digits[--nd];
+	buf[pos++] = '.';
+	buf[pos++] = digits[1];
+	buf[pos++] = digits[0];
+	buf[pos] = '\0';
+}
+
+// Appends 's', escaped for use in XML text or attribute values.
+static void svg_append_escaped(struct rs_graph *g, const char *s)
+{
+	char tmp[2];
+
+	for(; *s; s++) {
+		switch(*s) {
+		case '&': svg_append(g,"&amp;"); break;
+		case '<': svg_append(g,"&lt;"); break;
+		case '>': svg_append(g,"&gt;"); break;
+		case '"': svg_append(g,"&quot;"); break;
+		default:
+			tmp[0] = *s;
+			tmp[1] = '\0';
+			svg_append(g,tmp);
+		}
+	}
+}
+
+// Converts from logical coordinates to SVG coordinates. The PNG graph draws
+// a point at (x,y) in the pixel whose center is at (x+0.5,y+0.5).
+static double svg_x(struct rs_graph *g, double ix)
+{
+	return g->zero_x + (ix*g->unit_x) + 0.5;
+}
+static double svg_y(struct rs_graph *g, double iy)
+{
+	return g->zero_y + (iy*g->unit_y) + 0.5;
+}
+
+// (x,y) is the upper-left corner of the text, as with gr_string().
+static void svg_text(struct rs_graph *g, int x, int y, const char *s,
+	const char *color)
+{
+	char tmp[200];
+
+	sprintf(tmp, "<text x=\"%d\" y=\"%d\" fill=\"%s\">", x, y+10, color);
+	svg_append(g,tmp);
+	svg_append_escaped(g,s);
+	svg_append(g,"</text>\n");
+}
+
+// Appends a vertical line at x, and a horizontal line at y, to a path.
+// Lines outside the image are left out.
+static void svg_grid_lines(struct rs_graph *g, int x, int y)
+{
+	char tmp[80];
+
+	if(x>=0 && x<g->width) {
+		sprintf(tmp, "M%d.5 0V%d", x, g->height);
+		svg_append(g,tmp);
+	}
+	if(y>=0 && y<g->height) {
+		sprintf(tmp, "M0 %d.5H%d", y, g->width);
+		svg_append(g,tmp);
+	}
+}
+
+static void svg_begin(struct rs_graph *g, int pattern)
+{
+	int i;
+	int r, gg, b;
+	char tmp[300];
+
+	g->svg_data = NULL;
+	g->svg_len = g->svg_alloc = 0;
+	g->svg_nomem = 0;
+	gr_get_border_rgb(pattern,&r,&gg,&b);
+	sprintf(g->svg_border_color, "#%02x%02x%02x", r, gg, b);
+
+	sprintf(tmp, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+		"<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"%d\" height=\"%d\" "
+		"viewBox=\"0 0 %d %d\" font-family=\"monospace\" font-size=\"11\">\n",
+		g->width, g->height, g->width, g->height);
+	svg_append(g,tmp);
+	sprintf(tmp, "<rect width=\"%d\" height=\"%d\" fill=\"#ffffff\"/>\n",
+		g->width, g->height);
+	svg_append(g,tmp);
+
+	// Grid lines for half-integers, then integers. These, the axes, and the
+	// border are at the same positions as the pixels in the PNG graph.
+	svg_append(g,"<path stroke=\"#c0c0c0\" stroke-dasharray=\"4\" "
+		"stroke-dashoffset=\"1\" d=\"");
+	for(i= -10; i<=10; i++) {
+		svg_grid_lines(g,xcoord(g,0.5+(double)i),ycoord(g,0.5+(double)i));
+	}
+	svg_append(g,"\"/>\n");
+
+	svg_append(g,"<path stroke=\"#c0c0c0\" d=\"");
+	for(i= -10; i<=10; i++) {
+		svg_grid_lines(g,xcoord(g,i),ycoord(g,i));
+	}
+	svg_append(g,"\"/>\n");
+
+	// Axes
+	sprintf(tmp, "<path stroke=\"#000000\" d=\"M%d.5 0V%dM0 %d.5H%d\"/>\n",
+		xcoord(g,0.0), g->height, ycoord(g,0.0), g->width);
+	svg_append(g,tmp);
+
+	// Labels
+	for(i=0;i<=1;i++) {
+		sprintf(tmp, "%d", i);
+		svg_text(g,xcoord(g,i)-6,g->height-14,tmp,"#008000");
+		svg_text(g,3,ycoord(g,i)-12,tmp,"#008000");
+	}
+
+	sprintf(tmp, "<rect x=\"0.5\" y=\"0.5\" width=\"%d\" height=\"%d\" "
+		"fill=\"none\" stroke=\"%s\"/>\n",
+		g->width-1, g->height-1, g->svg_border_color);
+	svg_append(g,tmp);
+
+	if(g->include_logo) {
+		sprintf(tmp, "<rect x=\"%d\" y=\"%d\" width=\"81\" height=\"15\" fill=\"%s\"/>\n",
+			g->width-81, g->height-15, g->svg_border_color);
+		svg_append(g,tmp);
+		svg_text(g,g->width-79,g->height-15,"ResampleScope","#ffffff");
+	}
+}
+
+// Appends the next point of a path, unless it's the same as the previous one.
+// Points in the middle of a horizontal run are removed.
+static void svg_path_point(struct rs_graph *g, double x, double y)
+{
+	char xs[40], ys[40];
+
+	svg_format_coord(xs,x);
+	svg_format_coord(ys,y);
+	if(g->svg_num_points>0 && !strcmp(ys,g->svg_last_y)) {
+		if(!strcmp(xs,g->svg_last_x)) return;
+		if(g->svg_num_points>1 && g->svg_last_horizontal) {
+			// Replace the previous point
+			g->svg_len = g->svg_last_pos;
+			g->svg_data[g->svg_len] = '\0';
+			g->svg_num_points--;
+		}
+		g->svg_last_horizontal = 1;
+	}
+	else {
+		g->svg_last_horizontal = 0;
+	}
+
+	g->svg_last_pos = g->svg_len;
+	svg_append(g,(g->svg_num_points==0)?"M":"L");
+	svg_append(g,xs);
+	svg_append(g," ");
+	svg_append(g,ys);
+	strcpy(g->svg_last_x,xs);
+	strcpy(g->svg_last_y,ys);
+	g->svg_num_points++;
+}
+
+// Appends the lowest and highest points of a column, in the order they
+// occurred, then its last point.
+static void svg_path_column(struct rs_graph *g, double min_x, double min_y,
+	double max_x, double max_y, double last_x, double last_y)
+{
+	if(min_x<=max_x) {
+		svg_path_point(g,min_x,min_y);
+		svg_path_point(g,max_x,max_y);
+	}
+	else {
+		svg_path_point(g,max_x,max_y);
+		svg_path_point(g,min_x,min_y);
+	}
+	svg_path_point(g,last_x,last_y);
+}
+
+// Like gr_lineimg_graph_main(), but the columns are narrower than a pixel,
+// and the points keep their own x coordinates.
+static void svg_lineimg_graph_main(struct rs_graph *g, const struct rs_result *r)
+{
+	int i;
+	int col;
+	int col_x = 0;
+	int col_n = 0;
+	double x, y;
+	double min_x = 0.0, min_y = 0.0;
+	double max_x = 0.0, max_y = 0.0;
+	double last_x = 0.0, last_y = 0.0;
+
+	g->svg_num_points = 0;
+
+	for(i=0;i<r->num_samples;i++) {
+		x = svg_x(g,r->samples[i].x);
+		y = svg_y(g,r->samples[i].y);
+		col = (int)floor(x*SVG_COLUMNS_PER_PIXEL);
+
+		if(col_n>0 && col==col_x) {
+			if(y<min_y) { min_x = x; min_y = y; }
+			if(y>max_y) { max_x = x; max_y = y; }
+			last_x = x;
+			last_y = y;
+			col_n++;
+			continue;
+		}
+
+		if(col_n>1) {
+			svg_path_column(g,min_x,min_y,max_x,max_y,last_x,last_y);
+		}
+
+		svg_path_point(g,x,y);
+		col_x = col;
+		min_x = max_x = last_x = x;
+		min_y = max_y = last_y = y;
+		col_n = 1;
+	}
+
+	if(col_n>1) {
+		svg_path_column(g,min_x,min_y,max_x,max_y,last_x,last_y);
+	}
+}
+
+static void svg_dotimg_graph_main(struct rs_graph *g, const struct rs_result *r)
+{
+	int i;
+	double x, y;
+	char xs[40], ys[40];
+
+	// Each dot is a zero-length line, drawn with round caps.
+	for(i=0;i<r->num_samples;i++) {
+		x = svg_x(g,r->samples[i].x);
+		y = svg_y(g,r->samples[i].y);
+		if(x<0.0 || y<0.0 || x>g->width || y>g->height) continue;
+		svg_format_coord(xs,x);
+		svg_format_coord(ys,y);
+		svg_append(g,"M");
+		svg_append(g,xs);
+		svg_append(g," ");
+		svg_append(g,ys);
+		svg_append(g,"h0");
+	}
+}
+
+static void svg_plot(struct rs_graph *g, const struct rsg_style *st,
+	const struct rs_result *r)
+{
+	int ypos;
+	char color[8];
+	char name[100];
+	char tmp[200];
+
+	sprintf(color, "#%02x%02x%02x", st->color_r&0xff, st->color_g&0xff,
+		st->color_b&0xff);
+
+	// Legend
+	ypos = gr_legend_ypos(g);
+	sprintf(tmp, "<path stroke=\"%s\" stroke-width=\"%d\" d=\"M5 %d.5H14\"/>\n",
+		color, st->thicklines?3:1, ypos+7);
+	svg_append(g,tmp);
+	gr_get_graph_name(st,r,name);
+	svg_text(g,17,ypos,name,color);
+
+	if(r->pattern==PATTERN_DOTIMG) {
+		sprintf(tmp, "<path stroke=\"%s\" stroke-width=\"%s\" "
+			"stroke-linecap=\"round\" d=\"", color, st->thicklines?"3":"1.5");
+		svg_append(g,tmp);
+		svg_dotimg_graph_main(g,r);
+	}
+	else {
+		sprintf(tmp, "<path fill=\"none\" stroke=\"%s\" stroke-width=\"%d\" "
+			"stroke-linejoin=\"round\" d=\"", color, st->thicklines?3:1);
+		svg_append(g,tmp);
+		svg_lineimg_graph_main(g,r);
+	}
+	svg_append(g,"\"/>\n");
+}
+
+const char *rsg_finish_svg(struct rs_graph *g, size_t *len)
+{
+	svg_append(g,"</svg>\n");
+	if(g->svg_nomem) return NULL;
+	*len = g->svg_len;
+	return g->svg_data;
+}
+
+///////////////////////////////////////////////
+
+void rsg_begin(struct rs_graph *g, int pattern)
+{
+	struct rsr_image **cached = NULL;
+
+	gr_init(g);
+
+	if(g->svg) {
+		svg_begin(g,pattern);
+		return;
+	}
+
+	if(g->cache) {
+		cached = &g->cache->im[pattern][g->expandrange][g->include_logo?1:0];
+		if(*cached) {
+			g->im = rsr_clone(*cached);
+			if(!g->im) return;
+			gr_set_border_color(g,pattern);
+			return;
+		}
+	}
+
+	g->im = rsr_create(g->width,g->height);
+	if(!g->im) return;
+	rsr_filled_rectangle(g->im,0,0,g->width-1,g->height-1,
+	 rsr_color_resolve(g->im,255,255,255));
+	gr_set_border_color(g,pattern);
+	gr_draw_grid(g);
+	gr_draw_logo(g);
+
+	if(cached) {
+		*cached = rsr_clone(g->im);
+	}
+}
+
+//////////////////// DOTIMG ////////////////////
+
+// Plot the samples from the dot pattern. Points that are safely inside the
+// image are written straight to the pixel buffer.
+static void gr_dotimg_graph_main(struct rs_graph *g, const struct rsg_style *st,
+	const struct rs_result *r)
+{
+	int i;
+	int xc,yc;
+	int w = g->im->width;
+	unsigned char clr = (unsigned char)g->curr_color;
+	unsigned char *p;
+
+	for(i=0;i<r->num_samples;i++) {
+		xc = xcoord(g,r->samples[i].x);
+		yc = ycoord(g,r->samples[i].y);
+		if(!point_is_visible(g,xc,yc)) continue;
+
+		if(xc<1 || yc<1 || xc>=g->width-1 || yc>=g->height-1) {
+			rsr_set_pixel(g->im,xc,yc,clr);
+			if(st->thicklines) {
+				rsr_set_pixel(g->im,xc-1,yc,clr);
+				rsr_set_pixel(g->im,xc+1,yc,clr);
+				rsr_set_pixel(g->im,xc,yc-1,clr);
+				rsr_set_pixel(g->im,xc,yc+1,clr);
+			}
+			continue;
+		}
+
+		p = &g->im->pixels[(size_t)yc*w+xc];
+		p[0] = clr;
+		if(st->thicklines) {
+			p[-1] = clr;
+			p[1] = clr;
+			p[-w] = clr;
+			p[w] = clr;
+		}
+	}
+}
+
+//////////////////// LINEIMG ///////////////////
+
+// Plot the samples from the line pattern, connecting them with lines.
+// When there are many samples per pixel column (a very large image), the
+// lines between the samples in the same column are all vertical, and
+// together they cover exactly the pixels from the lowest sample to the
+// highest. So each run of samples in the same column is reduced to its
+// first, lowest, highest, and last points, which draws the same pixels with
+// at most four lines per column.
+static void gr_lineimg_graph_main(struct rs_graph *g, const struct rsg_style *st,
+	const struct rs_result *r)
+{
+	int i;
+	int xc, yc;
+	int col_x = 0;
+	int col_n = 0; // Number of samples in the current column
+	int col_min = 0, col_max = 0, col_last = 0;
+
+	if(st->thicklines)
+		rsr_set_thickness(g->im,3);
+
+	for(i=0;i<r->num_samples;i++) {
+		xc = xcoord(g,r->samples[i].x);
+		yc = ycoord(g,r->samples[i].y);
+
+		if(col_n>0 && xc==col_x) {
+			if(yc<col_min) col_min = yc;
+			if(yc>col_max) col_max = yc;
+			col_last = yc;
+			col_n++;
+			continue;
+		}
+
+		// Finish the previous column
+		if(col_n>1) {
+			gr_lineto(g,col_x,col_min,g->curr_color);
+			gr_lineto(g,col_x,col_max,g->curr_color);
+			gr_lineto(g,col_x,col_last,g->curr_color);
+		}
+
+		// The line from the previous column to the first point of this one
+		gr_lineto(g,xc,yc,g->curr_color);
+		col_x = xc;
+		col_min = col_max = col_last = yc;
+		col_n = 1;
+	}
+
+	if(col_n>1) {
+		gr_lineto(g,col_x,col_min,g->curr_color);
+		gr_lineto(g,col_x,col_max,g->curr_color);
+		gr_lineto(g,col_x,col_last,g->curr_color);
+	}
+
+	rsr_set_thickness(g->im,1);
+}
+
+///////////////////////////////////////////////
+
+void rsg_plot(struct rs_graph *g, const struct rsg_style *st,
+	const struct rs_result *r)
+{
+	if(g->svg) {
+		svg_plot(g,st,r);
+		g->graph_count++;
+		return;
+	}
+
+	g->curr_color = rsr_color_resolve(g->im,
+	  st->color_r,st->color_g,st->color_b);
+	g->lastpos_set = 0;
+
+	gr_draw_graph_name(g,st,r);
+	if(r->pattern==PATTERN_DOTIMG)
+		gr_dotimg_graph_main(g,st,r);
+	else
+		gr_lineimg_graph_main(g,st,r);
+
+	g->graph_count++;
+}
+
+void rsg_skip(struct rs_graph *g)
+{
+	g->graph_count++;
+}
+
+int rsg_is_drawing(const struct rs_graph *g)
+{
+	if(g->svg) return g->svg_data!=NULL && !g->svg_nomem;
+	return g->im!=NULL;
+}
+
+void rsg_end(struct rs_graph *g)
+{
+	free(g->svg_data);
+	g->svg_data = NULL;
+	g->svg_len = g->svg_alloc = 0;
+	g->svg_nomem = 0;
+	if(g->im) {
+		rsr_destroy(g->im);
+		g->im = NULL;
+	}
+}
+
+void rsg_cache_free(struct rsg_cache *cache)
+{
+	int i, j, k;
+
+	for(i=0;i<3;i++) {
+		for(j=0;j<3;j++) {
+			for(k=0;k<2;k++) {
+				rsr_destroy(cache->im[i][j][k]);
+				cache->im[i][j][k] = NULL;
+			}
+		}
+	}
+}
@@ -0,0 +1,102 @@
+// ResampleScope graph renderer
+// Copyright (C) 2011-2017 Jason Summers
+
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+// Draws graphs of the results from librscope. The graphs are drawn to a
+// paletted image in memory (see rsraster.h), or as an SVG image.
+
+#ifndef RSGRAPH_H
+#define RSGRAPH_H
+
+#include "librscope.h"
+#include "rsraster.h"
+
+// Pre-rendered graph backgrounds (grid, axes, logo), reused when drawing
+// many graphs.
+struct rsg_cache {
+	// Indexed by [pattern][expandrange][include_logo]
+	struct rsr_image *im[3][3][2];
+};
+
+// How to draw one set of results.
+struct rsg_style {
+	const char *name; // Friendly name, for the legend
+	int thicklines;
+	int color_r, color_g, color_b;
+};
+
+struct rs_graph {
+	// Settings. These must be set before calling rsg_begin().
+	int include_logo;
+	int expandrange; // 0, 1, or 2: Increase the visible vertical range
+	struct rsg_cache *cache; // If not NULL, used to save and reuse the backgrounds
+	int svg; // Draw an SVG image (svg_data), instead of a raster image (im)
+
+	// The raster image. NULL if not drawing one.
+	struct rsr_image *im;
+
+	// Information about the output image coordinates.
+	int width, height;
+	double zero_x, zero_y;
+	double unit_x, unit_y;
+
+	int border_color;
+
+	// Preferred color to use to for information about the current results.
+	int curr_color;
+
+	// Tracks how many graphs we've plotted on this output image.
+	int graph_count;
+
+	// Used by the line drawing function
+	int lastpos_set;
+	int lastpos_x, lastpos_y;
+
+	// The SVG image, if drawing one. It's a string of svg_len bytes.
+	char *svg_data;
+	size_t svg_len, svg_alloc;
+	int svg_nomem;
+	char svg_border_color[8];
+	int svg_num_points; // In the current path
+	char svg_last_x[40], svg_last_y[40]; // The previous point
+	size_t svg_last_pos; // Where the previous point starts in svg_data
+	int svg_last_horizontal; // If the previous point ended a horizontal line
+};
+
+// Creates g->im (or the SVG image), and draws everything that doesn't depend
+// on the results.
+void rsg_begin(struct rs_graph *g, int pattern);
+
+// Draws one set of results, and its entry in the legend.
+void rsg_plot(struct rs_graph *g, const struct rsg_style *st,
+	const struct rs_result *r);
+
+// Leaves an empty space in the legend, for results that couldn't be plotted.
+void rsg_skip(struct rs_graph *g);
+
+// Returns nonzero if the graph was created successfully by rsg_begin(),
+// and hasn't run out of memory since.
+int rsg_is_drawing(const struct rs_graph *g);
+
+// Finishes the SVG image, and returns it as a string of *len bytes, which
+// remains valid until rsg_end(). Returns NULL if out of memory.
+const char *rsg_finish_svg(struct rs_graph *g, size_t *len);
+
+// Destroys g->im, or the SVG image.
+void rsg_end(struct rs_graph *g);
+
+void rsg_cache_free(struct rsg_cache *cache);
+
+#endif // RSGRAPH_H
@@ -0,0 +1,351 @@
+// ResampleScope image file reader
+// Copyright (C) 2011-2017 Jason Summers
+
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "rsinput.h"
+
+static void set_errmsg(struct rsinput *in, const char *s)
+{
+	size_t n;
+
+	n = strlen(s);
+	if(n>sizeof(in->errmsg)-1) n=sizeof(in->errmsg)-1;
+	memcpy(in->errmsg,s,n);
+	in->errmsg[n] = '\0';
+}
+
+int rsin_raw_format_from_name(const char *name)
+{
+	if(!strcmp(name,"gray8")) return RSIN_RAW_GRAY8;
+	if(!strcmp(name,"rgb8")) return RSIN_RAW_RGB8;
+	if(!strcmp(name,"rgba8")) return RSIN_RAW_RGBA8;
+	if(!strcmp(name,"gray16")) return RSIN_RAW_GRAY16;
+	return 0;
+}
+
+//////////////////// LOW-LEVEL I/O ////////////////////
+
+// Returns the next byte of the file, or EOF.
+static int in_getc(struct rsinput *in)
+{
+	if(in->fp) return getc(in->fp);
+	if(in->mem_pos>=in->mem_size) return EOF;
+	return in->mem[in->mem_pos++];
+}
+
+static int in_read(struct rsinput *in, unsigned char *buf, size_t n)
+{
+	if(in->fp) {
+		if(fread(buf,1,n,in->fp)==n) return 1;
+	}
+	else if(n <= in->mem_size-in->mem_pos) {
+		memcpy(buf,&in->mem[in->mem_pos],n);
+		in->mem_pos += n;
+		return 1;
+	}
+	set_errmsg(in,"Unexpected end of file");
+	return 0;
+}
+
+static int in_skip(struct rsinput *in, size_t n)
+{
+	if(in->fp) {
+		if(fseek(in->fp,(long)n,SEEK_CUR)==0) return 1;
+	}
+	else if(n <= in->mem_size-in->mem_pos) {
+		in->mem_pos += n;
+		return 1;
+	}
+	set_errmsg(in,"Unexpected end of file");
+	return 0;
+}
+
+//////////////////// PNM ////////////////////
+
+// Reads the next whitespace-delimited token of a PNM header, skipping
+// comments. The whitespace character after the token is also read.
+static int pnm_read_token(struct rsinput *in, char *buf, size_t buflen)
+{
+	size_t n = 0;
+	int ch;
+
+	// Skip whitespace and comments
+	while(1) {
+		ch = in_getc(in);
+		if(ch=='#') {
+			while(ch!='\n' && ch!=EOF) {
+				ch = in_getc(in);
+			}
+		}
+		if(ch==EOF) return 0;
+		if(ch!=' ' && ch!='\t' && ch!='\r' && ch!='\n') break;
+	}
+
+	while(ch!=EOF && ch!=' ' && ch!='\t' && ch!='\r' && ch!='\n') {
+		if(n>=buflen-1) return 0;
+		buf[n++] = (char)ch;
+		ch = in_getc(in);
+	}
+	buf[n] = '\0';
+	return 1;
+}
+
+static int pnm_read_int(struct rsinput *in, int *v)
+{
+	char buf[20];
+
+	if(!pnm_read_token(in,buf,sizeof(buf))) return 0;
+	*v = atoi(buf);
+	return 1;
+}
+
+// Reads the header of a PAM file, after the "P7".
+static int pam_read_header(struct rsinput *in)
+{
+	char buf[80];
+
+	while(1) {
+		if(!pnm_read_token(in,buf,sizeof(buf))) return 0;
+		if(!strcmp(buf,"ENDHDR")) return 1;
+
+		if(!strcmp(buf,"WIDTH")) {
+			if(!pnm_read_int(in,&in->width)) return 0;
+		}
+		else if(!strcmp(buf,"HEIGHT")) {
+			if(!pnm_read_int(in,&in->height)) return 0;
+		}
+		else if(!strcmp(buf,"DEPTH")) {
+			if(!pnm_read_int(in,&in->samples_per_pixel)) return 0;
+		}
+		else if(!strcmp(buf,"MAXVAL")) {
+			if(!pnm_read_int(in,&in->maxval)) return 0;
+		}
+		else if(!strcmp(buf,"TUPLTYPE")) {
+			if(!pnm_read_token(in,buf,sizeof(buf))) return 0;
+		}
+		else {
+			return 0;
+		}
+	}
+}
+
+static int pnm_open(struct rsinput *in)
+{
+	char magic[3];
+	int ok;
+
+	in->format = RSIN_FMT_PNM;
+	if(!pnm_read_token(in,magic,sizeof(magic))) goto bad;
+
+	if(magic[1]=='7') {
+		ok = pam_read_header(in);
+	}
+	else {
+		in->samples_per_pixel = (magic[1]=='6') ? 3 : 1;
+		ok = pnm_read_int(in,&in->width) && pnm_read_int(in,&in->height) &&
+			pnm_read_int(in,&in->maxval);
+	}
+	if(!ok || in->width<1 || in->height<1 || in->maxval<1 || in->maxval>65535 ||
+		in->samples_per_pixel<1 || in->samples_per_pixel>4)
+	{
+		goto bad;
+	}
+
+	in->file_bytes_per_sample = (in->maxval>255) ? 2 : 1;
+	in->big_endian = 1;
+	return 1;
+
+bad:
+	set_errmsg(in,"Invalid PNM file header");
+	return 0;
+}
+
+//////////////////// RAW ////////////////////
+
+static int raw_open(struct rsinput *in, const struct rsin_raw *raw)
+{
+	in->format = RSIN_FMT_RAW;
+	in->width = raw->width;
+	in->height = raw->height;
+	in->file_bytes_per_sample = 1;
+	in->maxval = 255;
+
+	switch(raw->format) {
+	case RSIN_RAW_RGB8:
+		in->samples_per_pixel = 3;
+		break;
+	case RSIN_RAW_RGBA8:
+		in->samples_per_pixel = 4;
+		break;
+	case RSIN_RAW_GRAY16:
+		in->samples_per_pixel = 1;
+		in->file_bytes_per_sample = 2;
+		in->maxval = 65535;
+		in->big_endian = 0;
+		break;
+	default:
+		in->samples_per_pixel = 1;
+	}
+
+	if(in->width<1 || in->height<1) {
+		set_errmsg(in,"Raw image size not set (use -size)");
+		return 0;
+	}
+	return 1;
+}
+
+///////////////////////////////////////////////
+
+int rsin_open(struct rsinput *in, FILE *fp, const void *data, size_t size,
+	const struct rsin_raw *raw)
+{
+	unsigned char sig[8];
+	size_t sig_len;
+	int ok;
+
+	memset(in,0,sizeof(struct rsinput));
+	in->fp = fp;
+	in->mem = (const unsigned char*)data;
+	in->mem_size = size;
+
+	// Look at the first few bytes to decide the format.
+	if(fp) {
+		rewind(fp);
+		sig_len = fread(sig,1,8,fp);
+		rewind(fp);
+	}
+	else {
+		sig_len = (size<8) ? size : 8;
+		memcpy(sig,data,sig_len);
+	}
+
+	if(sig_len==8 && !png_sig_cmp(sig,0,8)) {
+		in->format = RSIN_FMT_PNG;
+		if(fp)
+			ok = rspng_open(&in->png,fp);
+		else
+			ok = rspng_open_mem(&in->png,data,size);
+		if(!ok) {
+			set_errmsg(in,in->png.errmsg);
+			return 0;
+		}
+		in->width = in->png.width;
+		in->height = in->png.height;
+		in->samples_per_pixel = in->png.samples_per_pixel;
+		in->channel = in->png.channel;
+		in->bit_depth = in->png.bit_depth;
+		in->file_bytes_per_sample = in->bit_depth/8;
+		in->big_endian = 1;
+		in->maxval = (in->bit_depth==16) ? 65535 : 255;
+	}
+	else {
+		if(sig_len>=3 && sig[0]=='P' && (sig[1]=='5' || sig[1]=='6' || sig[1]=='7') &&
+			(sig[2]==' ' || sig[2]=='\t' || sig[2]=='\r' || sig[2]=='\n'))
+		{
+			ok = pnm_open(in);
+		}
+		else if(raw && raw->format) {
+			ok = raw_open(in,raw);
+		}
+		else {
+			set_errmsg(in,"Unknown file format");
+			return 0;
+		}
+		if(!ok) return 0;
+
+		in->channel = (in->samples_per_pixel>=3) ? 1 : 0;
+		// Samples with a maxval other than 255 are rescaled to 16 bits.
+		in->bit_depth = (in->maxval==255) ? 8 : 16;
+	}
+
+	in->file_rowbytes = (size_t)in->width*in->samples_per_pixel*in->file_bytes_per_sample;
+	in->file_row = malloc(in->file_rowbytes);
+	if(!in->file_row) {
+		set_errmsg(in,"Out of memory");
+		return 0;
+	}
+	return 1;
+}
+
+int rsin_read_row(struct rsinput *in, void *row)
+{
+	unsigned short *row16 = (unsigned short*)row;
+	const unsigned char *b;
+	size_t i, n;
+	unsigned long v;
+
+	if(in->format==RSIN_FMT_PNG) {
+		if(in->bit_depth==8) {
+			if(!rspng_read_row(&in->png,(unsigned char*)row)) goto pngerr;
+			return 1;
+		}
+		if(!rspng_read_row(&in->png,in->file_row)) goto pngerr;
+	}
+	else if(in->bit_depth==8) {
+		// Already in the right format
+		return in_read(in,(unsigned char*)row,in->file_rowbytes);
+	}
+	else {
+		if(!in_read(in,in->file_row,in->file_rowbytes)) return 0;
+	}
+
+	// Convert to 16-bit samples
+	n = (size_t)in->width*in->samples_per_pixel;
+	b = in->file_row;
+	for(i=0;i<n;i++) {
+		if(in->file_bytes_per_sample==1)
+			v = b[i];
+		else if(in->big_endian)
+			v = ((unsigned long)b[2*i]<<8) | b[2*i+1];
+		else
+			v = ((unsigned long)b[2*i+1]<<8) | b[2*i];
+
+		if(in->maxval!=65535) {
+			if(v>(unsigned long)in->maxval) v = in->maxval;
+			v = (v*65535 + in->maxval/2)/in->maxval;
+		}
+		row16[i] = (unsigned short)v;
+	}
+	return 1;
+
+pngerr:
+	set_errmsg(in,in->png.errmsg);
+	return 0;
+}
+
+int rsin_skip_row(struct rsinput *in)
+{
+	if(in->format==RSIN_FMT_PNG) {
+		// PNG rows are compressed, so they have to be decoded anyway.
+		if(!rspng_read_row(&in->png,in->file_row)) {
+			set_errmsg(in,in->png.errmsg);
+			return 0;
+		}
+		return 1;
+	}
+	return in_skip(in,in->file_rowbytes);
+}
+
+void rsin_close(struct rsinput *in)
+{
+	if(in->format==RSIN_FMT_PNG) {
+		rspng_close(&in->png);
+	}
+	free(in->file_row);
+	in->file_row = NULL;
+}
@@ -0,0 +1,91 @@
+// ResampleScope image file reader
+// Copyright (C) 2011-2017 Jason Summers
+
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+// Reads PNG, PGM/PPM/PAM, and headerless raw image files one row at a time.
+// The file format is detected from its first few bytes.
+
+#ifndef RSINPUT_H
+#define RSINPUT_H
+
+#include <stdio.h>
+
+#include "rspng.h"
+
+#define RSIN_FMT_PNG 1
+#define RSIN_FMT_PNM 2 // Binary PGM (P5), PPM (P6), or PAM (P7)
+#define RSIN_FMT_RAW 3
+
+#define RSIN_RAW_GRAY8  1
+#define RSIN_RAW_RGB8   2
+#define RSIN_RAW_RGBA8  3
+#define RSIN_RAW_GRAY16 4 // Little-endian
+
+// Describes headerless raw files, which can't be detected.
+struct rsin_raw {
+	int format; // RSIN_RAW_*, or 0 if raw files are not expected
+	int width, height;
+};
+
+struct rsinput {
+	int format; // RSIN_FMT_*
+
+	// Available after rsin_open().
+	int width, height;
+	int samples_per_pixel; // In the rows returned by rsin_read_row()
+	int channel; // Offset of the green (or gray) sample in each pixel
+	int bit_depth; // 8 (unsigned char samples) or 16 (unsigned short)
+
+	struct rspng png; // For RSIN_FMT_PNG
+
+	// The file is read from fp if it's not NULL, otherwise from mem.
+	FILE *fp;
+	const unsigned char *mem;
+	size_t mem_size;
+	size_t mem_pos;
+
+	// For PNM and raw files
+	int file_bytes_per_sample;
+	int maxval; // The largest possible sample value
+	int big_endian;
+	size_t file_rowbytes;
+	unsigned char *file_row; // Temporary space for one row of the file
+
+	char errmsg[200];
+};
+
+// Parses the name used with "-format" to RSIN_RAW_*. Returns 0 if it's not
+// recognized.
+int rsin_raw_format_from_name(const char *name);
+
+// Reads the file header from the start of fp if it's not NULL, otherwise
+// from the 'size' bytes at 'data'. 'raw' may be NULL.
+// Returns 0 on failure, and sets in->errmsg. In any case, 'in' must
+// eventually be freed with rsin_close().
+int rsin_open(struct rsinput *in, FILE *fp, const void *data, size_t size,
+	const struct rsin_raw *raw);
+
+// Reads the next row to 'row', which must have room for
+// in->width*in->samples_per_pixel samples of in->bit_depth bits.
+// Returns 0 on failure, and sets in->errmsg.
+int rsin_read_row(struct rsinput *in, void *row);
+
+// Skips over the next row. This may be faster than reading it.
+// Returns 0 on failure, and sets in->errmsg.
+int rsin_skip_row(struct rsinput *in);
+
+void rsin_close(struct rsinput *in);
+
+#endif // RSINPUT_H
@@ -0,0 +1,327 @@
+// ResampleScope PNG reader and writer
+// Copyright (C) 2011-2017 Jason Summers
+
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "rspng.h"
+
+static void set_errmsg(struct rspng *p, const char *s)
+{
+	size_t n;
+
+	n = strlen(s);
+	if(n>sizeof(p->errmsg)-1) n=sizeof(p->errmsg)-1;
+	memcpy(p->errmsg,s,n);
+	p->errmsg[n] = '\0';
+}
+
+static void my_png_error_fn(png_structp png_ptr, const char *err_msg)
+{
+	struct rspng *p = (struct rspng*)png_get_error_ptr(png_ptr);
+
+	set_errmsg(p,err_msg);
+	png_longjmp(png_ptr,1);
+}
+
+static void my_png_warning_fn(png_structp png_ptr, const char *warn_msg)
+{
+	;
+}
+
+static void my_png_read_mem_fn(png_structp png_ptr, png_bytep buf, png_size_t len)
+{
+	struct rspng *p = (struct rspng*)png_get_io_ptr(png_ptr);
+
+	if(len > p->mem_size-p->mem_pos) {
+		png_error(png_ptr,"Unexpected end of file");
+	}
+	memcpy(buf,&p->mem[p->mem_pos],len);
+	p->mem_pos += len;
+}
+
+// Reads the header, from fp if it's not NULL, otherwise from p->mem.
+// The signature has already been read.
+static int open_common(struct rspng *p, FILE *fp)
+{
+	png_uint_32 width, height;
+	int bit_depth, color_type, interlace_type;
+	int y;
+
+	p->png_ptr = png_create_read_struct(PNG_LIBPNG_VER_STRING,
+		(void*)p,my_png_error_fn,my_png_warning_fn);
+	if(!p->png_ptr) goto nomem;
+	p->info_ptr = png_create_info_struct(p->png_ptr);
+	if(!p->info_ptr) goto nomem;
+
+	if(setjmp(png_jmpbuf(p->png_ptr))) {
+		return 0;
+	}
+
+	if(fp)
+		png_init_io(p->png_ptr,fp);
+	else
+		png_set_read_fn(p->png_ptr,(void*)p,my_png_read_mem_fn);
+	png_set_sig_bytes(p->png_ptr,8);
+	png_read_info(p->png_ptr,p->info_ptr);
+	png_get_IHDR(p->png_ptr,p->info_ptr,&width,&height,&bit_depth,&color_type,
+		&interlace_type,NULL,NULL);
+
+	// Convert everything to 8- or 16-bit gray or RGB, with or without alpha.
+	// The alpha channel is ignored, the same as when gd was used to read the
+	// file.
+	if(color_type==PNG_COLOR_TYPE_PALETTE)
+		png_set_palette_to_rgb(p->png_ptr);
+	if(color_type==PNG_COLOR_TYPE_GRAY && bit_depth<8)
+		png_set_expand_gray_1_2_4_to_8(p->png_ptr);
+	if(interlace_type!=PNG_INTERLACE_NONE)
+		png_set_interlace_handling(p->png_ptr);
+	png_read_update_info(p->png_ptr,p->info_ptr);
+
+	p->width = (int)width;
+	p->height = (int)height;
+	p->samples_per_pixel = png_get_channels(p->png_ptr,p->info_ptr);
+	p->channel = (p->samples_per_pixel>=3) ? 1 : 0;
+	p->bit_depth = png_get_bit_depth(p->png_ptr,p->info_ptr);
+	p->rowbytes = png_get_rowbytes(p->png_ptr,p->info_ptr);
+
+	if(interlace_type!=PNG_INTERLACE_NONE) {
+		p->image = malloc(p->rowbytes*(size_t)p->height);
+		p->row_pointers = malloc(sizeof(png_bytep)*(size_t)p->height);
+		if(!p->image || !p->row_pointers) goto nomem;
+		for(y=0;y<p->height;y++) {
+			p->row_pointers[y] = &p->image[p->rowbytes*(size_t)y];
+		}
+		png_read_image(p->png_ptr,p->row_pointers);
+	}
+
+	return 1;
+
+nomem:
+	set_errmsg(p,"Out of memory");
+	return 0;
+}
+
+int rspng_open(struct rspng *p, FILE *fp)
+{
+	unsigned char sig[8];
+
+	memset(p,0,sizeof(struct rspng));
+
+	if(fread(sig,1,8,fp)!=8 || png_sig_cmp(sig,0,8)) {
+		set_errmsg(p,"Not a PNG file");
+		return 0;
+	}
+	return open_common(p,fp);
+}
+
+int rspng_open_mem(struct rspng *p, const void *data, size_t size)
+{
+	memset(p,0,sizeof(struct rspng));
+
+	if(size<8 || png_sig_cmp((png_const_bytep)data,0,8)) {
+		set_errmsg(p,"Not a PNG file");
+		return 0;
+	}
+	p->mem = (const unsigned char*)data;
+	p->mem_size = size;
+	p->mem_pos = 8;
+	return open_common(p,NULL);
+}
+
+int rspng_read_row(struct rspng *p, unsigned char *row)
+{
+	if(p->next_row>=p->height) {
+		set_errmsg(p,"Too many rows requested");
+		return 0;
+	}
+
+	if(p->image) {
+		memcpy(row,p->row_pointers[p->next_row],p->rowbytes);
+	}
+	else {
+		if(setjmp(png_jmpbuf(p->png_ptr))) {
+			return 0;
+		}
+		png_read_row(p->png_ptr,row,NULL);
+	}
+
+	p->next_row++;
+	return 1;
+}
+
+void rspng_close(struct rspng *p)
+{
+	if(p->png_ptr) {
+		png_destroy_read_struct(&p->png_ptr, p->info_ptr ? &p->info_ptr : NULL, NULL);
+	}
+	free(p->image);
+	p->image = NULL;
+	free(p->row_pointers);
+	p->row_pointers = NULL;
+}
+
+//////////////////// WRITING ////////////////////
+
+static void wset_errmsg(struct rspngw *p, const char *s)
+{
+	size_t n;
+
+	n = strlen(s);
+	if(n>sizeof(p->errmsg)-1) n=sizeof(p->errmsg)-1;
+	memcpy(p->errmsg,s,n);
+	p->errmsg[n] = '\0';
+}
+
+static void my_png_werror_fn(png_structp png_ptr, const char *err_msg)
+{
+	struct rspngw *p = (struct rspngw*)png_get_error_ptr(png_ptr);
+
+	wset_errmsg(p,err_msg);
+	png_longjmp(png_ptr,1);
+}
+
+static void my_png_write_mem_fn(png_structp png_ptr, png_bytep buf, png_size_t len)
+{
+	struct rspngw *p = (struct rspngw*)png_get_io_ptr(png_ptr);
+	size_t newalloc;
+	unsigned char *newmem;
+
+	if(len > p->mem_alloc-p->mem_size) {
+		newalloc = p->mem_alloc*2;
+		if(newalloc < p->mem_size+len) newalloc = p->mem_size+len;
+		if(newalloc < 4096) newalloc = 4096;
+		newmem = realloc(p->mem,newalloc);
+		if(!newmem) {
+			png_error(png_ptr,"Out of memory");
+		}
+		p->mem = newmem;
+		p->mem_alloc = newalloc;
+	}
+	memcpy(&p->mem[p->mem_size],buf,len);
+	p->mem_size += len;
+}
+
+static void my_png_flush_mem_fn(png_structp png_ptr)
+{
+	;
+}
+
+// The smallest bit depth that can hold the given number of palette indices.
+static int palette_bit_depth(int num_colors)
+{
+	if(num_colors<=2) return 1;
+	if(num_colors<=4) return 2;
+	if(num_colors<=16) return 4;
+	return 8;
+}
+
+int rspngw_open(struct rspngw *p, FILE *fp, int width, int height,
+	const unsigned char (*palette)[3], int num_colors, int level)
+{
+	png_color pngpal[256];
+	int i;
+
+	memset(p,0,sizeof(struct rspngw));
+	p->fp = fp;
+
+	p->png_ptr = png_create_write_struct(PNG_LIBPNG_VER_STRING,
+		(void*)p,my_png_werror_fn,my_png_warning_fn);
+	if(!p->png_ptr) goto nomem;
+	p->info_ptr = png_create_info_struct(p->png_ptr);
+	if(!p->info_ptr) goto nomem;
+
+	if(setjmp(png_jmpbuf(p->png_ptr))) {
+		return 0;
+	}
+
+	if(fp)
+		png_init_io(p->png_ptr,fp);
+	else
+		png_set_write_fn(p->png_ptr,(void*)p,my_png_write_mem_fn,my_png_flush_mem_fn);
+
+	if(level!=RSPNG_DEFAULT_LEVEL) {
+		png_set_compression_level(p->png_ptr,level);
+	}
+	if(level==0 || num_colors>0) {
+		// Filtering is pointless if the data isn't compressed, and rarely
+		// helps paletted images.
+		png_set_filter(p->png_ptr,PNG_FILTER_TYPE_BASE,PNG_FILTER_NONE);
+	}
+	else if(level>=1 && level<=3) {
+		// Instead of trying every filter on every row, use the one that
+		// works best for the patterns, whose rows are often repeated.
+		png_set_filter(p->png_ptr,PNG_FILTER_TYPE_BASE,PNG_FILTER_UP);
+	}
+
+	if(num_colors>0) {
+		for(i=0;i<num_colors;i++) {
+			pngpal[i].red = palette[i][0];
+			pngpal[i].green = palette[i][1];
+			pngpal[i].blue = palette[i][2];
+		}
+		png_set_IHDR(p->png_ptr,p->info_ptr,(png_uint_32)width,(png_uint_32)height,
+			palette_bit_depth(num_colors),PNG_COLOR_TYPE_PALETTE,PNG_INTERLACE_NONE,
+			PNG_COMPRESSION_TYPE_BASE,PNG_FILTER_TYPE_BASE);
+		png_set_PLTE(p->png_ptr,p->info_ptr,pngpal,num_colors);
+	}
+	else {
+		png_set_IHDR(p->png_ptr,p->info_ptr,(png_uint_32)width,(png_uint_32)height,
+			8,PNG_COLOR_TYPE_GRAY,PNG_INTERLACE_NONE,
+			PNG_COMPRESSION_TYPE_BASE,PNG_FILTER_TYPE_BASE);
+	}
+
+	png_write_info(p->png_ptr,p->info_ptr);
+
+	// The rows we're given always have one byte per pixel.
+	if(num_colors>0 && palette_bit_depth(num_colors)<8) {
+		png_set_packing(p->png_ptr);
+	}
+	return 1;
+
+nomem:
+	wset_errmsg(p,"Out of memory");
+	return 0;
+}
+
+int rspngw_write_row(struct rspngw *p, const unsigned char *row)
+{
+	if(setjmp(png_jmpbuf(p->png_ptr))) {
+		return 0;
+	}
+	png_write_row(p->png_ptr,(png_const_bytep)row);
+	return 1;
+}
+
+int rspngw_finish(struct rspngw *p)
+{
+	if(setjmp(png_jmpbuf(p->png_ptr))) {
+		return 0;
+	}
+	png_write_end(p->png_ptr,NULL);
+	if(p->fp && ferror(p->fp)) {
+		wset_errmsg(p,"Write error");
+		return 0;
+	}
+	return 1;
+}
+
+void rspngw_close(struct rspngw *p)
+{
+	if(p->png_ptr) {
+		png_destroy_write_struct(&p->png_ptr, p->info_ptr ? &p->info_ptr : NULL);
+	}
+}
@@ -0,0 +1,106 @@
+// ResampleScope PNG reader and writer
+// Copyright (C) 2011-2017 Jason Summers
+
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+// Reads and writes PNG files one row at a time, using libpng, so that a
+// huge image never has to be in memory all at once.
+
+#ifndef RSPNG_H
+#define RSPNG_H
+
+#include <stdio.h>
+#include <png.h>
+
+struct rspng {
+	png_structp png_ptr;
+	png_infop info_ptr;
+
+	// Available after rspng_open().
+	int width, height;
+	int samples_per_pixel; // In the rows returned by rspng_read_row()
+	int channel; // Offset of the green (or gray) sample in each pixel
+	int bit_depth; // 8, or 16 (big-endian)
+
+	int next_row;
+
+	// For rspng_open_mem()
+	const unsigned char *mem;
+	size_t mem_size;
+	size_t mem_pos;
+
+	// Interlaced images can't be read one row at a time, so they are read
+	// all at once, into 'image'.
+	unsigned char *image;
+	png_bytep *row_pointers;
+	size_t rowbytes;
+
+	char errmsg[200];
+};
+
+// Reads the PNG header. Returns 0 on failure, and sets p->errmsg.
+// In any case, p must eventually be freed with rspng_close().
+int rspng_open(struct rspng *p, FILE *fp);
+
+// Like rspng_open(), but reads a PNG file that is already in memory. The
+// memory must remain valid until rspng_close().
+int rspng_open_mem(struct rspng *p, const void *data, size_t size);
+
+// Reads the next row to 'row', which must have room for
+// p->width*p->samples_per_pixel*(p->bit_depth/8) bytes.
+// Returns 0 on failure, and sets p->errmsg.
+int rspng_read_row(struct rspng *p, unsigned char *row);
+
+void rspng_close(struct rspng *p);
+
+// Writing
+
+// A zlib compression level (0-9), or this for libpng's default.
+#define RSPNG_DEFAULT_LEVEL (-1)
+
+struct rspngw {
+	png_structp png_ptr;
+	png_infop info_ptr;
+
+	// The file is written to fp if it's not NULL, otherwise to mem, which is
+	// allocated with malloc(), and must be freed by the caller.
+	FILE *fp;
+	unsigned char *mem;
+	size_t mem_size;
+	size_t mem_alloc;
+
+	char errmsg[200];
+};
+
+// Writes the PNG header, for an image with 8-bit samples: grayscale if
+// num_colors is 0, otherwise paletted. Images with few colors are written
+// with fewer bits per pixel.
+// 'level' is the zlib compression level, or RSPNG_DEFAULT_LEVEL. Level 0
+// stores the image uncompressed, and levels 1-3 use a single fast filter.
+// Returns 0 on failure, and sets p->errmsg. In any case, p must eventually
+// be freed with rspngw_close().
+int rspngw_open(struct rspngw *p, FILE *fp, int width, int height,
+	const unsigned char (*palette)[3], int num_colors, int level);
+
+// Writes the next row, of 'width' samples (or palette indices).
+// Returns 0 on failure, and sets p->errmsg.
+int rspngw_write_row(struct rspngw *p, const unsigned char *row);
+
+// Writes the end of the file. Returns 0 on failure, and sets p->errmsg.
+int rspngw_finish(struct rspngw *p);
+
+// Frees everything except p->mem.
+void rspngw_close(struct rspngw *p);
+
+#endif // RSPNG_H
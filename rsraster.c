@@ -0,0 +1,342 @@
+// ResampleScope raster drawing
+// Copyright (C) 2011-2017 Jason Summers
+
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "rsraster.h"
+
+// The length of each dash, and each gap, drawn by rsr_dashed_line().
+#define RSR_DASH_SIZE 4
+
+struct rsr_image *rsr_create(int width, int height)
+{
+	struct rsr_image *im;
+
+	im = calloc(1,sizeof(struct rsr_image));
+	if(!im) return NULL;
+	im->pixels = calloc((size_t)width*height,1);
+	if(!im->pixels) {
+		free(im);
+		return NULL;
+	}
+	im->width = width;
+	im->height = height;
+	im->thickness = 1;
+	return im;
+}
+
+struct rsr_image *rsr_clone(const struct rsr_image *im)
+{
+	struct rsr_image *im2;
+	unsigned char *pixels;
+
+	im2 = malloc(sizeof(struct rsr_image));
+	pixels = malloc((size_t)im->width*im->height);
+	if(!im2 || !pixels) {
+		free(im2);
+		free(pixels);
+		return NULL;
+	}
+	memcpy(im2,im,sizeof(struct rsr_image));
+	memcpy(pixels,im->pixels,(size_t)im->width*im->height);
+	im2->pixels = pixels;
+	return im2;
+}
+
+void rsr_destroy(struct rsr_image *im)
+{
+	if(!im) return;
+	free(im->pixels);
+	free(im);
+}
+
+int rsr_color_resolve(struct rsr_image *im, int r, int g, int b)
+{
+	int i;
+	int dr, dg, db;
+	long dist;
+	long best_dist = 0;
+	int best = 0;
+
+	for(i=0;i<im->num_colors;i++) {
+		dr = im->palette[i][0] - r;
+		dg = im->palette[i][1] - g;
+		db = im->palette[i][2] - b;
+		dist = (long)dr*dr + (long)dg*dg + (long)db*db;
+		if(dist==0) return i;
+		if(i==0 || dist<best_dist) {
+			best = i;
+			best_dist = dist;
+		}
+	}
+
+	if(im->num_colors>=RSR_MAX_COLORS) return best;
+
+	i = im->num_colors++;
+	im->palette[i][0] = (unsigned char)r;
+	im->palette[i][1] = (unsigned char)g;
+	im->palette[i][2] = (unsigned char)b;
+	return i;
+}
+
+void rsr_set_thickness(struct rsr_image *im, int thickness)
+{
+	im->thickness = thickness;
+}
+
+void rsr_set_pixel(struct rsr_image *im, int x, int y, int clr)
+{
+	if(x<0 || y<0 || x>=im->width || y>=im->height) return;
+	im->pixels[(size_t)y*im->width+x] = (unsigned char)clr;
+}
+
+void rsr_filled_rectangle(struct rsr_image *im, int x1, int y1, int x2, int y2, int clr)
+{
+	int tmp;
+	int y;
+
+	if(x1>x2) { tmp=x1; x1=x2; x2=tmp; }
+	if(y1>y2) { tmp=y1; y1=y2; y2=tmp; }
+	if(x1<0) x1=0;
+	if(y1<0) y1=0;
+	if(x2>im->width-1) x2=im->width-1;
+	if(y2>im->height-1) y2=im->height-1;
+	if(x1>x2) return;
+
+	for(y=y1;y<=y2;y++) {
+		memset(&im->pixels[(size_t)y*im->width+x1],clr,(size_t)(x2-x1+1));
+	}
+}
+
+// Clips the line from (*x0,*y0) to (*x1,*y1) in the x dimension, the same way
+// gd does. (Call it with the coordinates swapped to clip in the y dimension.)
+// Returns 0 if the line is entirely outside the image.
+static int clip_1d(int *x0, int *y0, int *x1, int *y1, int mindim, int maxdim)
+{
+	double m; // Slope of the line
+
+	if(*x0<mindim) {
+		if(*x1<mindim) return 0;
+		m = (*y1 - *y0)/(double)(*x1 - *x0);
+		*y0 -= (int)(m*(*x0 - mindim));
+		*x0 = mindim;
+		if(*x1>maxdim) {
+			*y1 = (int)(*y1 + m*(maxdim - *x1));
+			*x1 = maxdim;
+		}
+		return 1;
+	}
+	if(*x0>maxdim) {
+		if(*x1>maxdim) return 0;
+		m = (*y1 - *y0)/(double)(*x1 - *x0);
+		*y0 += (int)(m*(maxdim - *x0));
+		*x0 = maxdim;
+		if(*x1<mindim) {
+			*y1 -= (int)(m*(*x1 - mindim));
+			*x1 = mindim;
+		}
+		return 1;
+	}
+	if(*x1>maxdim) {
+		m = (*y1 - *y0)/(double)(*x1 - *x0);
+		*y1 += (int)(m*(maxdim - *x1));
+		*x1 = maxdim;
+		return 1;
+	}
+	if(*x1<mindim) {
+		m = (*y1 - *y0)/(double)(*x1 - *x0);
+		*y1 -= (int)(m*(*x1 - mindim));
+		*x1 = mindim;
+	}
+	return 1;
+}
+
+// Draws 'wid' pixels centered on (x,y), in a column if 'vert' is set,
+// otherwise in a row.
+static void draw_span(struct rsr_image *im, int x, int y, int wid, int vert, int clr)
+{
+	int w;
+
+	if(wid==1) {
+		rsr_set_pixel(im,x,y,clr);
+		return;
+	}
+	if(vert) {
+		for(w=y-wid/2;w<y-wid/2+wid;w++) rsr_set_pixel(im,x,w,clr);
+	}
+	else {
+		for(w=x-wid/2;w<x-wid/2+wid;w++) rsr_set_pixel(im,w,y,clr);
+	}
+}
+
+// Bresenham's algorithm, as used by gd. Each step draws a span of pixels
+// perpendicular to the major axis, so that a thick line has roughly the
+// requested thickness. If 'dashed' is set, the steps alternate between
+// dashes and gaps, and the line is one pixel thick.
+static void draw_line_steps(struct rsr_image *im, int x1, int y1, int x2, int y2,
+	int clr, int dashed)
+{
+	int dx, dy;
+	int x, y, end;
+	int d, incr1, incr2;
+	int dir; // Direction of the minor axis
+	int wid; // Length of each span
+	int vert; // Whether the spans are vertical
+	int on = 1;
+	int dash_step = 0;
+	int first = 1;
+	double a;
+
+	dx = abs(x2-x1);
+	dy = abs(y2-y1);
+	vert = (dy<=dx);
+
+	wid = 1;
+	if(im->thickness>1 && !dashed) {
+		a = atan2((double)dy,(double)dx);
+		a = vert ? cos(a) : sin(a);
+		if(a!=0.0) wid = (int)(im->thickness/a);
+		if(wid==0) wid = 1;
+	}
+
+	// Always draw from left to right, or from top to bottom.
+	if(vert) {
+		d = 2*dy - dx;
+		incr1 = 2*dy;
+		incr2 = 2*(dy-dx);
+		if(x1>x2) { x = x2; y = y2; end = x1; dir = (y1>y2) ? 1 : -1; }
+		else { x = x1; y = y1; end = x2; dir = (y2>y1) ? 1 : -1; }
+	}
+	else {
+		d = 2*dx - dy;
+		incr1 = 2*dx;
+		incr2 = 2*(dx-dy);
+		if(y1>y2) { x = x2; y = y2; end = y1; dir = (x1>x2) ? 1 : -1; }
+		else { x = x1; y = y1; end = y2; dir = (x2>x1) ? 1 : -1; }
+	}
+
+	while(1) {
+		if(!first) {
+			if(d<0) {
+				d += incr1;
+			}
+			else {
+				if(vert) y += dir; else x += dir;
+				d += incr2;
+			}
+		}
+		first = 0;
+
+		if(dashed) {
+			dash_step++;
+			if(dash_step==RSR_DASH_SIZE) {
+				dash_step = 0;
+				on = !on;
+			}
+		}
+		if(on) draw_span(im,x,y,wid,vert,clr);
+
+		if(vert) {
+			if(x>=end) break;
+			x++;
+		}
+		else {
+			if(y>=end) break;
+			y++;
+		}
+	}
+}
+
+void rsr_line(struct rsr_image *im, int x1, int y1, int x2, int y2, int clr)
+{
+	int half;
+	int tmp;
+	int i;
+
+	if(!clip_1d(&x1,&y1,&x2,&y2,0,im->width-1)) return;
+	if(!clip_1d(&y1,&x1,&y2,&x2,0,im->height-1)) return;
+
+	if(x1==x2) {
+		if(im->thickness>1) {
+			half = im->thickness/2;
+			rsr_filled_rectangle(im,x1-half,y1,x1+im->thickness-half-1,y2,clr);
+			return;
+		}
+		if(y1>y2) { tmp=y1; y1=y2; y2=tmp; }
+		for(i=y1;i<=y2;i++) {
+			im->pixels[(size_t)i*im->width+x1] = (unsigned char)clr;
+		}
+		return;
+	}
+	if(y1==y2) {
+		if(im->thickness>1) {
+			half = im->thickness/2;
+			rsr_filled_rectangle(im,x1,y1-half,x2,y1+im->thickness-half-1,clr);
+			return;
+		}
+		if(x1>x2) { tmp=x1; x1=x2; x2=tmp; }
+		memset(&im->pixels[(size_t)y1*im->width+x1],clr,(size_t)(x2-x1+1));
+		return;
+	}
+
+	draw_line_steps(im,x1,y1,x2,y2,clr,0);
+}
+
+void rsr_dashed_line(struct rsr_image *im, int x1, int y1, int x2, int y2, int clr)
+{
+	draw_line_steps(im,x1,y1,x2,y2,clr,1);
+}
+
+void rsr_rectangle(struct rsr_image *im, int x1, int y1, int x2, int y2, int clr)
+{
+	int tmp;
+	int saved_thickness;
+
+	if(x1>x2) { tmp=x1; x1=x2; x2=tmp; }
+	if(y1>y2) { tmp=y1; y1=y2; y2=tmp; }
+
+	saved_thickness = im->thickness;
+	im->thickness = 1;
+	rsr_line(im,x1,y1,x2,y1,clr);
+	rsr_line(im,x1,y2,x2,y2,clr);
+	if(y2-y1>1) {
+		rsr_line(im,x1,y1+1,x1,y2-1,clr);
+		rsr_line(im,x2,y1+1,x2,y2-1,clr);
+	}
+	im->thickness = saved_thickness;
+}
+
+void rsr_string(struct rsr_image *im, const struct rsr_font *f, int x, int y,
+	const unsigned char *s, int clr)
+{
+	const unsigned char *cdata;
+	int px, py;
+
+	for(; *s; s++, x+=f->w) {
+		if(*s<f->offset || *s>=f->offset+f->nchars) continue;
+		cdata = &f->data[(size_t)(*s-f->offset)*f->h];
+		for(py=0;py<f->h;py++) {
+			if(!cdata[py]) continue;
+			for(px=0;px<f->w;px++) {
+				if(cdata[py]&(0x80>>px)) {
+					rsr_set_pixel(im,x+px,y+py,clr);
+				}
+			}
+		}
+	}
+}
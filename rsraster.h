@@ -0,0 +1,78 @@
+// ResampleScope raster drawing
+// Copyright (C) 2011-2017 Jason Summers
+
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+// A minimal 8-bit paletted image, with the few drawing primitives that the
+// graphs need. The primitives draw exactly the same pixels as the gd
+// functions they replace (gdImageLine(), etc.), but write directly to the
+// pixel buffer, without gd's per-call overhead.
+
+#ifndef RSRASTER_H
+#define RSRASTER_H
+
+#define RSR_MAX_COLORS 256
+
+// A bitmap font, at most 8 pixels wide.
+struct rsr_font {
+	int nchars; // Number of characters
+	int offset; // Code of the first character
+	int w, h; // Size of each character
+	// h bytes per character, one for each row. The most significant bit is
+	// the leftmost pixel.
+	const unsigned char *data;
+};
+
+struct rsr_image {
+	int width, height;
+	unsigned char *pixels; // Palette indices; width*height, row by row
+	int num_colors;
+	unsigned char palette[RSR_MAX_COLORS][3];
+	int thickness; // For lines. Default 1.
+};
+
+// Returns NULL if out of memory. The palette is initially empty.
+struct rsr_image *rsr_create(int width, int height);
+
+// Returns a copy of 'im', or NULL if out of memory.
+struct rsr_image *rsr_clone(const struct rsr_image *im);
+
+void rsr_destroy(struct rsr_image *im);
+
+// Returns the palette index of the given color, adding it to the palette
+// if necessary. If the palette is full, returns the closest color.
+int rsr_color_resolve(struct rsr_image *im, int r, int g, int b);
+
+void rsr_set_thickness(struct rsr_image *im, int thickness);
+
+// Pixels outside the image are ignored.
+void rsr_set_pixel(struct rsr_image *im, int x, int y, int clr);
+
+// Draws a line, including both endpoints, with the current thickness.
+void rsr_line(struct rsr_image *im, int x1, int y1, int x2, int y2, int clr);
+
+// Draws a dashed line, one pixel thick. (For diagonal lines, gd would draw
+// thicker dashes; the graphs only need horizontal and vertical ones.)
+void rsr_dashed_line(struct rsr_image *im, int x1, int y1, int x2, int y2, int clr);
+
+// Draws the outline of a rectangle, one pixel thick.
+void rsr_rectangle(struct rsr_image *im, int x1, int y1, int x2, int y2, int clr);
+
+void rsr_filled_rectangle(struct rsr_image *im, int x1, int y1, int x2, int y2, int clr);
+
+// (x,y) is the upper-left corner of the first character.
+void rsr_string(struct rsr_image *im, const struct rsr_font *f, int x, int y,
+	const unsigned char *s, int clr);
+
+#endif // RSRASTER_H
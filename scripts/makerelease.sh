@@ -24,7 +24,7 @@ mkdir $D
 mkdir $D/x86
 cp -p Release/rscope.exe $D/x86/
 
-cp -p rscope.c readme.txt COPYING.txt Makefile $D/
+cp -p *.c *.h readme.txt COPYING.txt Makefile $D/
 
 mkdir $D/proj
 mkdir $D/proj/vs2008
@@ -34,7 +34,7 @@ mkdir $D/scripts
 cp -p scripts/* $D/scripts/
 
 
-cp -p rscope.c readme.txt COPYING.txt Makefile $D/
+cp -p *.c *.h readme.txt COPYING.txt Makefile $D/
 
 
 #zip -9 rscope-${VER}.zip rscope.c readme.txt COPYING.txt Makefile